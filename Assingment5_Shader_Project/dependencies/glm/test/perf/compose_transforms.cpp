@@ -0,0 +1,98 @@
+// Checks mgl::composeTransforms, on every SIMD path the CPU runs, against
+// composing the glm matrices: world = translate(t) * mat4_cast(q) * scale(s)
+// bit for bit, normal = transpose(inverse(mat3(world))) within tolerance.
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/ext/matrix_relational.hpp>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "mglTransform.hpp"
+
+struct nodes
+{
+	std::vector<glm::vec3> Translations;
+	std::vector<glm::quat> Rotations;
+	std::vector<glm::vec3> Scales;
+};
+
+// Non-uniform scales, negative ones included, never close to 0.
+static nodes make_nodes(std::size_t Count, unsigned int Seed)
+{
+	std::mt19937 Random(Seed);
+	std::uniform_real_distribution<float> Unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> Magnitude(0.2f, 3.0f);
+
+	nodes Nodes;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		Nodes.Translations.push_back(glm::vec3(Unit(Random), Unit(Random), Unit(Random)) * 100.0f);
+		glm::vec3 const Axis = glm::vec3(Unit(Random), Unit(Random), Unit(Random)) + glm::vec3(0.0f, 0.0f, 0.01f);
+		Nodes.Rotations.push_back(glm::angleAxis(Unit(Random) * 3.14159f, glm::normalize(Axis)));
+		glm::vec3 Scale(Magnitude(Random), Magnitude(Random), Magnitude(Random));
+		for(int c = 0; c < 3; ++c)
+			if(Unit(Random) < 0.0f)
+				Scale[c] = -Scale[c];
+		Nodes.Scales.push_back(Scale);
+	}
+	return Nodes;
+}
+
+static int test_path(mgl::SimdPath Path, std::size_t Count)
+{
+	nodes const Nodes = make_nodes(Count, static_cast<unsigned int>(Count));
+	std::vector<glm::mat4> Worlds(Count);
+	std::vector<glm::mat3> Normals(Count);
+
+	mgl::setSimdPath(Path);
+	mgl::composeTransforms(Count, Nodes.Translations.data(), Nodes.Rotations.data(),
+		Nodes.Scales.data(), Worlds.data(), Normals.data());
+
+	int Error = 0;
+	for(std::size_t i = 0; i < Count; ++i)
+	{
+		glm::mat4 const World = glm::translate(Nodes.Translations[i]) * glm::mat4_cast(Nodes.Rotations[i]) * glm::scale(Nodes.Scales[i]);
+		glm::mat3 const Normal = glm::transpose(glm::inverse(glm::mat3(World)));
+
+		Error += Worlds[i] == World ? 0 : 1;
+		for(int c = 0; c < 3; ++c)
+			Error += glm::all(glm::equal(Normals[i][c], Normal[c], 1e-4f * (1.0f + glm::length(Normal[c])))) ? 0 : 1;
+	}
+
+	// without normals only the world matrices are written
+	std::vector<glm::mat4> Alone(Count);
+	mgl::composeTransforms(Count, Nodes.Translations.data(), Nodes.Rotations.data(),
+		Nodes.Scales.data(), Alone.data(), nullptr);
+	for(std::size_t i = 0; i < Count; ++i)
+		Error += Alone[i] == Worlds[i] ? 0 : 1;
+
+	if(Error)
+		std::printf("%s, %d nodes: %d mismatch(es)\n", mgl::getSimdPathName(Path), static_cast<int>(Count), Error);
+	return Error;
+}
+
+int main()
+{
+	mgl::SimdPath const Default = mgl::getSimdPath();
+	mgl::SimdPath const Paths[] = { mgl::SCALAR, mgl::SSE4, mgl::AVX2 };
+	// counts around the 8-wide AVX2 loop leave remainders for its SSE4 tail
+	std::size_t const Counts[] = { 1, 3, 7, 8, 9, 17, 255, 1024 };
+
+	int Error = 0;
+	for(mgl::SimdPath Path : Paths)
+	{
+		mgl::setSimdPath(Path);
+		if(mgl::getSimdPath() != Path)
+		{
+			std::printf("%s: not supported, skipped\n", mgl::getSimdPathName(Path));
+			continue;
+		}
+		for(std::size_t Count : Counts)
+			Error += test_path(Path, Count);
+	}
+	mgl::setSimdPath(Default);
+
+	return Error;
+}
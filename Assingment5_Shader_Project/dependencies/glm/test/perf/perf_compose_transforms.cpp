@@ -0,0 +1,80 @@
+// Times mgl::composeTransforms on every SIMD path the CPU runs against
+// composing the glm matrices one node at a time, for a batch that stays in
+// cache and one that streams from memory. Each time is the best repeat.
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/transform.hpp>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "mglTransform.hpp"
+
+typedef std::chrono::high_resolution_clock clock_type;
+
+static double elapsed_us(clock_type::time_point Start)
+{
+	return std::chrono::duration<double, std::micro>(clock_type::now() - Start).count();
+}
+
+static int perf_batch(std::size_t Samples, int Repeats)
+{
+	std::vector<glm::vec3> Translations(Samples);
+	std::vector<glm::quat> Rotations(Samples);
+	std::vector<glm::vec3> Scales(Samples);
+	for(std::size_t i = 0; i < Samples; ++i)
+	{
+		float const f = static_cast<float>(i);
+		Translations[i] = glm::vec3(f, -f, 0.5f * f);
+		Rotations[i] = glm::angleAxis(0.001f * f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+		Scales[i] = glm::vec3(1.0f + 0.001f * f, -2.0f, 0.5f);
+	}
+	std::vector<glm::mat4> Worlds(Samples);
+	std::vector<glm::mat3> Normals(Samples);
+
+	std::printf("%d nodes\n", static_cast<int>(Samples));
+
+	double Best = 1e30;
+	for(int r = 0; r < Repeats; ++r)
+	{
+		clock_type::time_point const Start = clock_type::now();
+		for(std::size_t i = 0; i < Samples; ++i)
+		{
+			Worlds[i] = glm::translate(Translations[i]) * glm::mat4_cast(Rotations[i]) * glm::scale(Scales[i]);
+			Normals[i] = glm::transpose(glm::inverse(glm::mat3(Worlds[i])));
+		}
+		Best = glm::min(Best, elapsed_us(Start));
+	}
+	std::printf("- glm: %.1f us\n", Best);
+	glm::mat4 const Reference = Worlds[Samples - 1];
+
+	int Error = 0;
+	mgl::SimdPath const Default = mgl::getSimdPath();
+	mgl::SimdPath const Paths[] = { mgl::SCALAR, mgl::SSE4, mgl::AVX2 };
+	for(mgl::SimdPath Path : Paths)
+	{
+		mgl::setSimdPath(Path);
+		if(mgl::getSimdPath() != Path)
+			continue;
+		Best = 1e30;
+		for(int r = 0; r < Repeats; ++r)
+		{
+			clock_type::time_point const Start = clock_type::now();
+			mgl::composeTransforms(Samples, Translations.data(), Rotations.data(), Scales.data(), Worlds.data(), Normals.data());
+			Best = glm::min(Best, elapsed_us(Start));
+		}
+		std::printf("- %s: %.1f us%s\n", mgl::getSimdPathName(Path), Best, Path == Default ? " (default)" : "");
+		Error += Worlds[Samples - 1] == Reference ? 0 : 1;
+	}
+	mgl::setSimdPath(Default);
+
+	return Error;
+}
+
+int main()
+{
+	int Error = 0;
+	Error += perf_batch(4099, 200);
+	Error += perf_batch(100001, 20);
+	return Error;
+}
@@ -8,6 +8,9 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <cstring>
+#include <string>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
@@ -20,21 +23,48 @@ class MyApp : public mgl::App {
 public:
     void initCallback(GLFWwindow* win) override;
     void displayCallback(GLFWwindow* win, double elapsed) override;
+    void publishCallback(GLFWwindow* win) override;
+    void renderCallback(GLFWwindow* win, double elapsed) override;
+    void renderEventCallback(GLFWwindow* win, const mgl::RenderEvent& event) override;
     void windowSizeCallback(GLFWwindow* win, int width, int height) override;
     void keyCallback(GLFWwindow* win, int key, int scancode, int action, int mods) override;
     void cursorCallback(GLFWwindow* win, double xpos, double ypos) override;
     void mouseButtonCallback(GLFWwindow* win, int button, int action, int mods) override;
     void scrollCallback(GLFWwindow* win, double xoffset, double yoffset) override;
+    void setBenchmark(const std::string& output);
+    void setCompressedVertices(bool compressed);
+    void setMeshlets(bool split);
+    void setGpuDriven(bool enabled);
+    void setStaticBatching(bool enabled);
+    void setVertexPulling(bool enabled);
+    void setShaderWatching(bool enabled);
 
 private:
     const GLuint UBO_BP = 0;
+    const GLuint FRAME_BP = 1;
+    const GLuint OBJECT_BP = 2;
     mgl::Scenegraph* scenegraph = nullptr;
+    std::string benchmarkOutput;
+    bool compressedVertices = false;
+    bool meshlets = false;
+    bool gpuDriven = false;
+    bool staticBatching = false;
+    bool vertexPulling = false;
+    bool shaderWatching = false;
+
+    // Threaded [main thread publishes, render thread draws]
+    mgl::TripleBuffer<mgl::SceneSnapshot> snapshots;
+    mgl::SnapshotRenderer renderer;
 
     void cubeMesh();
     void createMeshes();
     void phongShader();
+    void phongVariants();
+    void cullShader();
+    void staticShader();
     void createShaderPrograms();
     void createScenegraph(bool reset);
+    void runBenchmark();
 };
 
 ///////////////////////////////////////////////////////////////////////// MESHES
@@ -44,38 +74,122 @@ void MyApp::cubeMesh() {
 
     mgl::Mesh* mesh = new mgl::Mesh();
     mesh->joinIdenticalVertices();
-    mesh->create(path);
+    mesh->optimize();
+    mesh->setCacheDirectory("./cache/meshes");
+    // the GPU-driven shaders read uncompressed normals, unless they pull
+    if (compressedVertices && (!gpuDriven || vertexPulling)) {
+        mesh->compressVertices();
+    }
+    if (meshlets) {
+        mesh->splitMeshlets();
+    }
+    // static nodes are baked from the CPU arrays
+    if (staticBatching) {
+        mesh->setRetention(mgl::VertexRetention::KEEP);
+    }
 
-    mgl::MeshManager::getInstance().add("cube", mesh);
+    // the scene can not be built without it
+    mgl::MeshManager::getInstance().load("cube", path, mesh,
+        [](const std::string& key, mgl::Mesh* mesh, const std::string& error) {
+            if (!mesh) exit(EXIT_FAILURE);
+        });
 }
 
 void MyApp::createMeshes() {
+    mgl::GeometryPool::getInstance().setVertexPulling(vertexPulling);
     cubeMesh();
 }
 
 ///////////////////////////////////////////////////////////////////////// SHADER
 
+// Objects come from the culling pass, not from an Object block.
 void MyApp::phongShader() {
 
     mgl::ShaderProgram* shader = new mgl::ShaderProgram();
-    shader->addShader(GL_VERTEX_SHADER, "./src/shaders/phong-vs.glsl");
+    shader->setCacheDirectory("./cache/shaders");
+    if (vertexPulling) {
+        // vertices come from the pool arena, whatever their format
+        shader->addShader(GL_VERTEX_SHADER, "./src/shaders/phong-pull-vs.glsl");
+    }
+    else {
+        shader->addShader(GL_VERTEX_SHADER, "./src/shaders/phong-gpu-vs.glsl");
+        shader->addAttribute(mgl::POSITION_ATTRIBUTE, mgl::Mesh::POSITION);
+        shader->addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
+    }
+    shader->addShader(GL_FRAGMENT_SHADER, "./src/shaders/phong-fs.glsl");
+    shader->addDefine(mgl::VERTEX_COLORS_DEFINE);
+
+    shader->addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
+    shader->addUniformBlock(mgl::FRAME_BLOCK, FRAME_BP);
+    shader->create();
+
+    mgl::ShaderManager::getInstance().add("phong", shader);
+}
+
+// One program per mesh format, built when a node first draws with it;
+// only the vertex shader tells compressed meshes apart.
+void MyApp::phongVariants() {
+
+    mgl::ShaderVariants* shaders = new mgl::ShaderVariants("phong");
+    shaders->setCacheDirectory("./cache/shaders");
+    shaders->addShader(GL_VERTEX_SHADER, "./src/shaders/phong-vs.glsl", mgl::COMPRESSED);
+    shaders->addShader(GL_FRAGMENT_SHADER, "./src/shaders/phong-fs.glsl", 0);
+
+    shaders->addAttribute(mgl::POSITION_ATTRIBUTE, mgl::Mesh::POSITION);
+    shaders->addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
+
+    shaders->addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
+    shaders->addUniformBlock(mgl::FRAME_BLOCK, FRAME_BP);
+    shaders->addUniformBlock(mgl::OBJECT_BLOCK, OBJECT_BP);
+
+    mgl::ShaderManager::getInstance().addVariants(shaders);
+}
+
+void MyApp::cullShader() {
+
+    mgl::ShaderProgram* shader = new mgl::ShaderProgram();
+    shader->setCacheDirectory("./cache/shaders");
+    shader->addShader(GL_COMPUTE_SHADER, "./src/shaders/cull-cs.glsl");
+
+    shader->addUniform(mgl::VIEW_PROJECTION_MATRIX);
+    shader->addUniform(mgl::EYE_POSITION);
+    shader->addUniform(mgl::PROJECTION_SCALE);
+    shader->addUniform(mgl::NODE_COUNT);
+    shader->create();
+
+    mgl::ShaderManager::getInstance().add("cull", shader);
+}
+
+void MyApp::staticShader() {
+
+    mgl::ShaderProgram* shader = new mgl::ShaderProgram();
+    shader->setCacheDirectory("./cache/shaders");
+    shader->addShader(GL_VERTEX_SHADER, "./src/shaders/phong-static-vs.glsl");
     shader->addShader(GL_FRAGMENT_SHADER, "./src/shaders/phong-fs.glsl");
+    shader->addDefine(mgl::VERTEX_COLORS_DEFINE);
 
     shader->addAttribute(mgl::POSITION_ATTRIBUTE, mgl::Mesh::POSITION);
     shader->addAttribute(mgl::NORMAL_ATTRIBUTE, mgl::Mesh::NORMAL);
+    shader->addAttribute(mgl::COLOR_ATTRIBUTE, mgl::Mesh::COLOR);
 
-    shader->addUniform(mgl::MODEL_MATRIX);
-    shader->addUniform(mgl::COLOR);
-    shader->addUniform(mgl::LIGHT_POSITION);
-    shader->addUniform(mgl::EYE_POSITION);
     shader->addUniformBlock(mgl::CAMERA_BLOCK, UBO_BP);
+    shader->addUniformBlock(mgl::FRAME_BLOCK, FRAME_BP);
     shader->create();
 
-    mgl::ShaderManager::getInstance().add("phong", shader);
+    mgl::ShaderManager::getInstance().add("phong-static", shader);
 }
 
 void MyApp::createShaderPrograms() {
-    phongShader();
+    if (gpuDriven) {
+        phongShader();
+        cullShader();
+    }
+    else {
+        phongVariants();
+    }
+    if (staticBatching) {
+        staticShader();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////// SCENEGRAPH
@@ -86,8 +200,18 @@ glm::mat4 R(1.0f);
 glm::mat4 T(1.0f);
 
 void MyApp::createScenegraph(bool reset) {
+    delete scenegraph;
     scenegraph = new mgl::Scenegraph("scenepraph1");
     scenegraph->createCamera(UBO_BP);
+    if (gpuDriven &&
+        !scenegraph->setGpuDriven(mgl::ShaderManager::getInstance().get("cull"))) {
+        // no per-node phong variants to fall back on
+        std::cerr << "ERROR: GPU-driven drawing could not be set up" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (staticBatching) {
+        scenegraph->setStaticBatching(mgl::ShaderManager::getInstance().get("phong-static"));
+    }
 
     if (!reset && scenegraph->load()) {
         return;
@@ -103,16 +227,17 @@ void MyApp::createScenegraph(bool reset) {
     scenegraph->setLight(glm::vec3(6.0f, 5.0f, 10.0f));
 
     // NODES
-    mgl::SceneNode* node = new mgl::SceneNode();
+    mgl::SceneNode* node = scenegraph->createNode();
     // scale(0.5)
     S = glm::scale(glm::vec3(0.5f));
     node->setModelMatrix(S, I, I);
 
     node->setMesh("cube");
     node->setShader("phong");
-    scenegraph->addNode(node);
+    // the base does not move
+    node->setStatic(true);
 
-    node = new mgl::SceneNode();
+    node = scenegraph->createNode();
     // scale(0.5)
     S = glm::scale(glm::vec3(0.2f));
     // rotate(45, (1, 1, 1))
@@ -125,21 +250,84 @@ void MyApp::createScenegraph(bool reset) {
     node->setColor(glm::vec3(1.0f, 0.0f, 0.0f));
     node->setMesh("cube");
     node->setShader("phong");
-    scenegraph->addNode(node);
 
     std::cout << "scenegraph created" << std::endl;
 }
 
+////////////////////////////////////////////////////////////////////// BENCHMARK
+
+void MyApp::setBenchmark(const std::string& output) {
+    benchmarkOutput = output;
+}
+
+void MyApp::setCompressedVertices(bool compressed) {
+    compressedVertices = compressed;
+}
+
+void MyApp::setMeshlets(bool split) {
+    meshlets = split;
+}
+
+// Snapshots of a threaded app are drawn item by item, so the flag only
+// applies to the single-threaded loop.
+void MyApp::setGpuDriven(bool enabled) {
+    gpuDriven = enabled && !mgl::Engine::getInstance().isThreaded();
+}
+
+// Static chunks are drawn by Scenegraph::submit, which a threaded app
+// does not call.
+void MyApp::setStaticBatching(bool enabled) {
+    staticBatching = enabled && !mgl::Engine::getInstance().isThreaded() &&
+        !vertexPulling;
+}
+
+// Only the GPU-driven scene draws with pulling shaders; static chunks
+// would need attributes, so they are left to the per-node path.
+void MyApp::setVertexPulling(bool enabled) {
+    vertexPulling = enabled && gpuDriven;
+}
+
+void MyApp::setShaderWatching(bool enabled) {
+    shaderWatching = enabled;
+}
+
+void MyApp::runBenchmark() {
+    mgl::Benchmark::Config config;
+    if (gpuDriven) {
+        config.culling = "cull";
+    }
+    mgl::Benchmark benchmark(config);
+    benchmark.run(UBO_BP);
+    benchmark.save(benchmarkOutput);
+}
+
 ////////////////////////////////////////////////////////////////////// CALLBACKS
 
 void MyApp::initCallback(GLFWwindow* win) {
+    if (gpuDriven && !mgl::GpuScene::isSupported()) {
+        // decided before meshes and shaders, which are chosen to match
+        std::cerr << "GPU-driven drawing needs OpenGL 4.6, drawing node by node"
+            << std::endl;
+        gpuDriven = false;
+        vertexPulling = false;
+    }
     createMeshes();
-    createShaderPrograms();  // after mesh;
+    createShaderPrograms();  // while meshes load
+    mgl::ShaderProgram::printCacheStats();
+    if (shaderWatching) {
+        mgl::ShaderManager::getInstance().watch();
+    }
+    mgl::MeshManager::getInstance().wait();
+    mgl::GeometryPool::getInstance().printStats();
     createScenegraph(false);
+
+    if (!benchmarkOutput.empty()) {
+        runBenchmark();
+        mgl::Engine::getInstance().close();
+    }
 }
 
 void MyApp::windowSizeCallback(GLFWwindow* win, int winx, int winy) {
-    glViewport(0, 0, winx, winy);
     // change projection matrices to maintain aspect ratio
     scenegraph->windowSizeCallback(win, winx, winy);
 }
@@ -153,6 +341,21 @@ void MyApp::keyCallback(GLFWwindow* win, int key, int scancode, int action, int
             std::cout << "reset scenegraph" << std::endl;
             createScenegraph(true);
             break;
+        case GLFW_KEY_I: {
+            const mgl::FrameStats stats = mgl::Engine::getInstance().getFrameStats();
+            std::cout << "frame time [p50 " << stats.getPercentile(50.0) << " ms, p95 "
+                << stats.getPercentile(95.0) << " ms, p99 " << stats.getPercentile(99.0)
+                << " ms, max " << stats.getMax() << " ms]" << std::endl;
+            break;
+        }
+#ifdef MGL_PROFILE
+        case GLFW_KEY_F: {
+            // last 120 frames
+            uint32_t frame = mgl::Profiler::getInstance().getFrame();
+            mgl::Profiler::getInstance().dump("trace.json", frame > 120 ? frame - 120 : 0, frame);
+            break;
+        }
+#endif
         default:
             break;
         }
@@ -163,6 +366,28 @@ void MyApp::displayCallback(GLFWwindow* win, double elapsed) {
     scenegraph->draw();
 }
 
+void MyApp::publishCallback(GLFWwindow* win) {
+    mgl::NodeHandle handle;
+    while (renderer.pollPick(handle)) {
+        scenegraph->select(handle);
+    }
+    scenegraph->snapshot(snapshots.write());
+    snapshots.publish();
+}
+
+void MyApp::renderCallback(GLFWwindow* win, double elapsed) {
+    const mgl::SceneSnapshot* snapshot = snapshots.read();
+    if (snapshot) {
+        renderer.draw(*snapshot);
+    }
+}
+
+void MyApp::renderEventCallback(GLFWwindow* win, const mgl::RenderEvent& event) {
+    if (event.type == mgl::RenderEvent::PICK) {
+        renderer.pick((int)event.x, (int)event.y);
+    }
+}
+
 void MyApp::cursorCallback(GLFWwindow* win, double xpos, double ypos) {
     scenegraph->cursorCallback(win, xpos, ypos);
 }
@@ -179,9 +404,52 @@ void MyApp::scrollCallback(GLFWwindow* win, double xoffset, double yoffset) {
 
 int main(int argc, char* argv[]) {
     mgl::Engine& engine = mgl::Engine::getInstance();
-    engine.setApp(new MyApp());
+    MyApp* app = new MyApp();
+    engine.setApp(app);
     engine.setOpenGL(4, 6);
     engine.setWindow(800, 600, "Shader Project", 0, 1);
+
+    // --headless [--frames N] [--seconds S] [--snapshot FILE.ppm]
+    // --benchmark FILE.json
+    // --fps N
+    // --on-demand
+    // --threaded
+    // --compress
+    // --meshlets
+    // --gpu-driven
+    // --static
+    // --pull
+    // --watch-shaders
+    bool headless = false;
+    bool gpuDriven = false;
+    bool staticBatching = false;
+    bool vertexPulling = false;
+    int frames = 0;
+    double seconds = 0.0;
+    const char* snapshot = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--headless")) headless = true;
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc) frames = std::stoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = std::stod(argv[++i]);
+        else if (!strcmp(argv[i], "--snapshot") && i + 1 < argc) snapshot = argv[++i];
+        else if (!strcmp(argv[i], "--benchmark") && i + 1 < argc) app->setBenchmark(argv[++i]);
+        else if (!strcmp(argv[i], "--fps") && i + 1 < argc) engine.setFrameLimit(std::stod(argv[++i]));
+        else if (!strcmp(argv[i], "--on-demand")) engine.setRedrawMode(mgl::RedrawMode::ON_DEMAND, 0.0);
+        else if (!strcmp(argv[i], "--threaded")) engine.setThreaded(true);
+        else if (!strcmp(argv[i], "--compress")) app->setCompressedVertices(true);
+        else if (!strcmp(argv[i], "--meshlets")) app->setMeshlets(true);
+        else if (!strcmp(argv[i], "--gpu-driven")) gpuDriven = true;
+        else if (!strcmp(argv[i], "--static")) staticBatching = true;
+        else if (!strcmp(argv[i], "--pull")) vertexPulling = true;
+        else if (!strcmp(argv[i], "--watch-shaders")) app->setShaderWatching(true);
+    }
+    app->setGpuDriven(gpuDriven);
+    app->setVertexPulling(vertexPulling);
+    app->setStaticBatching(staticBatching);
+    if (headless) {
+        engine.setHeadless(frames, seconds, snapshot);
+    }
+
     engine.init();
     engine.run();
     exit(EXIT_SUCCESS);
@@ -8,9 +8,16 @@
 
 #include "./mglApp.hpp"
 
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "./mglError.hpp"
+#include "./mglManager.hpp"
+#include "./mglProfiler.hpp"
+#include "./mglRingBuffer.hpp"
 
 namespace mgl {
 
@@ -22,6 +29,13 @@ namespace mgl {
 
     static void window_size_callback(GLFWwindow* window, int width, int height) {
         Engine::getInstance().getApp()->windowSizeCallback(window, width, height);
+        RenderEvent event = { RenderEvent::RESIZE, (double)width, (double)height };
+        Engine::getInstance().postRenderEvent(event);
+        Engine::getInstance().requestRedraw();
+    }
+
+    static void window_refresh_callback(GLFWwindow* window) {
+        Engine::getInstance().requestRedraw();
     }
 
     static void glfw_error_callback(int error, const char* description) {
@@ -55,12 +69,32 @@ namespace mgl {
 
     ////////////////////////////////////////////////////////////////////////// SETUP
 
+    // Seconds on a steady clock; GLFW's timer needs GLFW initialized, and a
+    // surfaceless headless run never initializes it.
+    static double getTime() {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     Engine::Engine(void) {
         GlApp = 0;
         Window = 0;
         WindowWidth = 640, WindowHeight = 480;
         GlMajor = 3, GlMinor = 3;
         Fullscreen = 0, Vsync = 0;
+        Headless = false;
+        HeadlessFrames = 0, HeadlessSeconds = 0.0;
+        HeadlessSnapshot = 0;
+        Closing = false;
+        FramebufferId = 0, ColorBufferId = 0, DepthStencilBufferId = 0;
+        FixedStep = 1.0 / 60.0, Accumulator = 0.0;
+        FrameLimit = 0.0, SleepError = 0.001;
+        Redraw = RedrawMode::CONTINUOUS, RedrawTimeout = 0.0;
+        RedrawRequested = true;
+        WakeRequested = false, Running = false;
+        StartTime = 0.0, Frames = 0;
+        Threaded = false, PendingRedraw = false;
+        Rendering = false;
         WindowTitle = "OpenGL App GLFW Window 2023(c) Carlos Martinho";
     }
 
@@ -89,11 +123,95 @@ namespace mgl {
         Vsync = vsync;
     }
 
+    // Runs without a visible window for a fixed number of frames and/or a
+    // fixed duration (whichever ends first), then prints frame statistics.
+    // The last frame is saved as a binary PPM if snapshot is given.
+    void Engine::setHeadless(int frames, double seconds, const char* snapshot) {
+        Headless = true;
+        HeadlessFrames = frames;
+        HeadlessSeconds = seconds;
+        HeadlessSnapshot = snapshot;
+        if (HeadlessFrames <= 0 && HeadlessSeconds <= 0.0) {
+            HeadlessFrames = 1;
+        }
+    }
+
+    bool Engine::isHeadless() { return Headless; }
+
+    void Engine::setFixedStep(double seconds) { FixedStep = seconds; }
+
+    // 0 disables the limiter (vsync, if on, still applies).
+    void Engine::setFrameLimit(double fps) { FrameLimit = fps; }
+
+    // A copy, as the render thread keeps adding to the stats.
+    FrameStats Engine::getFrameStats() {
+        std::lock_guard<std::mutex> lock(StatsMutex);
+        return Stats;
+    }
+
+    // ON_DEMAND only draws after requestRedraw(); a timeout > 0 also wakes
+    // the loop that often, for apps that poll something outside GLFW.
+    void Engine::setRedrawMode(RedrawMode mode, double timeout) {
+        Redraw = mode;
+        RedrawTimeout = timeout;
+        RedrawRequested = true;
+    }
+
+    // From the main thread when threaded, the render thread is woken after
+    // the change has been published, so it never redraws the old snapshot.
+    // From the GL context thread, its next loop draws.
+    void Engine::requestRedraw() {
+        if (Threaded && std::this_thread::get_id() == MainThread) PendingRedraw = true;
+        else RedrawRequested = true;
+    }
+
+    // Any thread. Wakes the GL context thread, idle on demand, to do work of
+    // its own such as uploads; it only draws if that work requests a redraw.
+    void Engine::wake() {
+        if (!Running) return;
+        if (Threaded) {
+            WakeRequested = true;
+            signalRender();
+        }
+        else if (Window) {
+            glfwPostEmptyEvent();
+        }
+    }
+
+    // Moves rendering to a thread of its own; set before init(). See App
+    // for which callbacks run on which thread.
+    void Engine::setThreaded(bool threaded) { Threaded = threaded; }
+
+    bool Engine::isThreaded() { return Threaded; }
+
+    // Main thread only; handled right away when not threaded.
+    void Engine::postRenderEvent(const RenderEvent& event) {
+        if (!Threaded) {
+            handleRenderEvent(event);
+            return;
+        }
+        if (!RenderEvents.push(event)) {
+            std::cerr << "render event dropped: queue full" << std::endl;
+            return;
+        }
+        signalRender();
+    }
+
     /////////////////////////////////////////////////////////////////////////// INIT
 
+    // Headless, a hidden window with an OSMesa context, else a native one.
     void Engine::setupWindow() {
-        GLFWmonitor* monitor = Fullscreen ? glfwGetPrimaryMonitor() : 0;
-        Window = glfwCreateWindow(WindowWidth, WindowHeight, WindowTitle, monitor, 0);
+        if (Headless) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+            Window = glfwCreateWindow(WindowWidth, WindowHeight, WindowTitle, 0, 0);
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+        }
+        if (!Window) {
+            GLFWmonitor* monitor =
+                Fullscreen && !Headless ? glfwGetPrimaryMonitor() : 0;
+            Window = glfwCreateWindow(WindowWidth, WindowHeight, WindowTitle,
+                monitor, 0);
+        }
         if (!Window) {
             glfwTerminate();
             exit(EXIT_FAILURE);
@@ -110,18 +228,46 @@ namespace mgl {
         glfwSetJoystickCallback(joystick_callback);
         glfwSetWindowCloseCallback(Window, window_close_callback);
         glfwSetWindowSizeCallback(Window, window_size_callback);
+        glfwSetWindowRefreshCallback(Window, window_refresh_callback);
     }
 
-    void Engine::setupGLFW() {
-        glfwSetErrorCallback(glfw_error_callback);
-        if (!glfwInit()) {
-            exit(EXIT_FAILURE);
-        }
+    void Engine::setupHints() {
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, GlMajor);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, GlMinor);
 #ifdef DEBUG
         glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 #endif
+        if (Headless) {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        }
+    }
+
+    // Headless tries a surfaceless context first, which needs no display
+    // server; the hidden window it falls back to does.
+    void Engine::setupGLFW() {
+        glfwSetErrorCallback(glfw_error_callback);
+        if (Headless) {
+#ifdef DEBUG
+            const bool debug = true;
+#else
+            const bool debug = false;
+#endif
+            if (Surfaceless.create(GlMajor, GlMinor, debug, WindowWidth,
+                WindowHeight)) {
+                return;
+            }
+            std::cerr << "headless: no surfaceless context, trying a hidden window"
+                << std::endl;
+        }
+        if (!glfwInit()) {
+            if (Headless) {
+                std::cerr << "ERROR headless: no display for a hidden window; a "
+                    "display-less run needs libEGL with EGL_MESA_platform_surfaceless"
+                    << std::endl;
+            }
+            exit(EXIT_FAILURE);
+        }
+        setupHints();
         setupWindow();
         setupCallbacks();
     }
@@ -131,6 +277,11 @@ namespace mgl {
         // Allow extension entry points to be loaded even if the extension isn't
         // present in the driver's extensions string.
         GLenum result = glewInit();
+        // Without a display GLEW loads the GL entry points, then fails on GLX;
+        // the context itself is complete.
+        if (Surfaceless.isCreated() && result == GLEW_ERROR_NO_GLX_DISPLAY) {
+            result = GLEW_OK;
+        }
         if (result != GLEW_OK) {
             std::cerr << "ERROR glewInit: " << glewGetString(result) << std::endl;
             exit(EXIT_FAILURE);
@@ -140,6 +291,53 @@ namespace mgl {
         // You might get GL_INVALID_ENUM when loading GLEW.
     }
 
+    void Engine::setupFramebuffer() {
+        glGenRenderbuffers(1, &ColorBufferId);
+        glBindRenderbuffer(GL_RENDERBUFFER, ColorBufferId);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WindowWidth, WindowHeight);
+
+        // stencil is needed for picking
+        glGenRenderbuffers(1, &DepthStencilBufferId);
+        glBindRenderbuffer(GL_RENDERBUFFER, DepthStencilBufferId);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WindowWidth,
+            WindowHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &FramebufferId);
+        glBindFramebuffer(GL_FRAMEBUFFER, FramebufferId);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_RENDERBUFFER, ColorBufferId);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+            GL_RENDERBUFFER, DepthStencilBufferId);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "ERROR: headless framebuffer incomplete" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    void Engine::destroyFramebuffer() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &FramebufferId);
+        glDeleteRenderbuffers(1, &ColorBufferId);
+        glDeleteRenderbuffers(1, &DepthStencilBufferId);
+    }
+
+    void Engine::saveSnapshot(const char* filename) {
+        std::vector<unsigned char> pixels(3 * WindowWidth * WindowHeight);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, WindowWidth, WindowHeight, GL_RGB, GL_UNSIGNED_BYTE,
+            pixels.data());
+
+        std::ofstream file(filename, std::ios::binary);
+        file << "P6\n" << WindowWidth << " " << WindowHeight << "\n255\n";
+        // OpenGL rows start at the bottom
+        for (int y = WindowHeight - 1; y >= 0; y--) {
+            file.write(reinterpret_cast<const char*>(&pixels[3 * WindowWidth * y]),
+                3 * WindowWidth);
+        }
+        std::cout << "snapshot saved on: " << filename << std::endl;
+    }
+
     void displayInfo() {
         std::cerr << "OpenGL Renderer: " << glGetString(GL_RENDERER) << " ("
             << glGetString(GL_VENDOR) << ")" << std::endl;
@@ -165,8 +363,12 @@ namespace mgl {
     }
 
     void Engine::init() {
+        MainThread = std::this_thread::get_id();
         setupGLFW();
         setupGLEW();
+        if (Headless) {
+            setupFramebuffer();
+        }
         setupOpenGL();
         GlApp->initCallback(Window);
 #ifdef DEBUG
@@ -177,19 +379,274 @@ namespace mgl {
 
     //////////////////////////////////////////////////////////////////////////// RUN
 
-    void Engine::run() {
-        double last_time = glfwGetTime();
-        while (!glfwWindowShouldClose(Window)) {
-            double time = glfwGetTime();
+    void Engine::update(double elapsed) {
+        // clamp so that a long stall does not trigger a burst of updates
+        Accumulator += elapsed < 0.25 ? elapsed : 0.25;
+        while (Accumulator >= FixedStep) {
+            GlApp->updateCallback(Window, FixedStep);
+            Accumulator -= FixedStep;
+        }
+    }
+
+    // Sleeping overshoots by up to the timer resolution, so sleep until
+    // a margin before the deadline (a slowly decaying worst overshoot) and
+    // spin the rest.
+    void Engine::limitFrame(double frame_start) {
+        if (FrameLimit <= 0.0) return;
+        double deadline = frame_start + 1.0 / FrameLimit;
+        double remaining = deadline - getTime();
+        if (remaining > SleepError) {
+            double before = getTime();
+            std::this_thread::sleep_for(
+                std::chrono::duration<double>(remaining - SleepError));
+            double overshoot = getTime() - before - (remaining - SleepError);
+            SleepError = overshoot > SleepError ? overshoot : 0.99 * SleepError;
+        }
+        while (getTime() < deadline) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Shows the frame. Headless, waits for it instead and ends the run once
+    // enough frames or seconds have gone by.
+    void Engine::present() {
+        if (Headless) {
+            // nothing to swap, wait for the frame so timings are real
+            glFinish();
+            Frames++;
+            if ((HeadlessFrames > 0 && Frames >= HeadlessFrames) ||
+                (HeadlessSeconds > 0.0 &&
+                    getTime() - StartTime >= HeadlessSeconds)) {
+                close();
+            }
+        }
+        else {
+            glfwSwapBuffers(Window);
+        }
+    }
+
+    // Ends the run after the current loop; any thread.
+    void Engine::close() {
+        if (Window) {
+            glfwSetWindowShouldClose(Window, GLFW_TRUE);
+            glfwPostEmptyEvent();
+        }
+        else {
+            Closing = true;
+        }
+    }
+
+    bool Engine::shouldClose() {
+        return Window ? glfwWindowShouldClose(Window) != 0 : Closing.load();
+    }
+
+    // Binds the GL context to the calling thread, or releases it.
+    void Engine::makeCurrent(bool current) {
+        if (Window) glfwMakeContextCurrent(current ? Window : 0);
+        else Surfaceless.makeCurrent(current);
+    }
+
+    void Engine::handleRenderEvent(const RenderEvent& event) {
+        if (event.type == RenderEvent::RESIZE) {
+            glViewport(0, 0, (GLsizei)event.x, (GLsizei)event.y);
+        }
+        else {
+            GlApp->renderEventCallback(Window, event);
+        }
+    }
+
+    // Taking the lock orders the change before the render thread's check,
+    // so a wake-up can not fall between its check and its wait.
+    void Engine::signalRender() {
+        { std::lock_guard<std::mutex> lock(RenderMutex); }
+        RenderSignal.notify_one();
+    }
+
+    // Shortest of the redraw timeout and the shader manager's; 0 waits for
+    // an event.
+    double Engine::getIdleTimeout() {
+        double timeout = ShaderManager::getInstance().getIdleTimeout();
+        if (RedrawTimeout > 0.0 && (timeout <= 0.0 || RedrawTimeout < timeout)) {
+            timeout = RedrawTimeout;
+        }
+        return timeout;
+    }
+
+    void Engine::runSingle() {
+        double last_time = StartTime;
+        bool idled = false;
+        while (!shouldClose()) {
+            // before the idle check, so loads and shader reloads finish
+            // without a redraw; each one finished requests one
+            MeshManager::getInstance().upload();
+            ShaderManager::getInstance().update();
+            if (Redraw == RedrawMode::ON_DEMAND && !RedrawRequested && !Headless) {
+                double timeout = getIdleTimeout();
+                if (timeout > 0.0) glfwWaitEventsTimeout(timeout);
+                else glfwWaitEvents();
+                idled = true;
+                continue;
+            }
+            RedrawRequested = false;
+            if (idled) {
+                // time spent waiting is neither frame time nor update time
+                last_time = getTime();
+            }
+            MGL_PROFILE_FRAME
+            MGL_PROFILE_SCOPE("Engine::run")
+            MGL_PROFILE_GPU_SCOPE("frame")
+            double time = getTime();
             double elapsed_time = time - last_time;
             last_time = time;
+            if (time > StartTime && !idled) {
+                std::lock_guard<std::mutex> lock(StatsMutex);
+                Stats.add(elapsed_time);
+            }
+            idled = false;
+            update(elapsed_time);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            RingBuffer::getInstance().beginFrame();
             GlApp->displayCallback(Window, elapsed_time);
-            glfwSwapBuffers(Window);
-            glfwPollEvents();
+            RingBuffer::getInstance().endFrame();
+            present();
+            if (Window) glfwPollEvents();
+            limitFrame(time);
+        }
+    }
+
+    // Main thread: GLFW events, input callbacks, fixed updates, and one
+    // snapshot published per wake-up. The GL context belongs to the render
+    // thread until it is joined.
+    void Engine::runThreaded() {
+        makeCurrent(false);
+        Rendering = true;
+        std::thread renderer(&Engine::renderLoop, this);
+        double last_time = StartTime;
+        while (!shouldClose()) {
+            if (Redraw == RedrawMode::ON_DEMAND && !Headless) {
+                if (RedrawTimeout > 0.0) glfwWaitEventsTimeout(RedrawTimeout);
+                else glfwWaitEvents();
+            }
+            else if (Window) {
+                // wake at least once per step so updates keep running
+                glfwWaitEventsTimeout(FixedStep);
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::duration<double>(FixedStep));
+            }
+            MGL_PROFILE_SCOPE("Engine::publish")
+            double time = getTime();
+            double elapsed_time = time - last_time;
+            last_time = time;
+            if (Redraw == RedrawMode::ON_DEMAND && elapsed_time > FixedStep) {
+                // time spent waiting is not update time
+                elapsed_time = FixedStep;
+            }
+            update(elapsed_time);
+            GlApp->publishCallback(Window);
+            if (PendingRedraw) {
+                PendingRedraw = false;
+                RedrawRequested = true;
+                signalRender();
+            }
+        }
+        Rendering = false;
+        signalRender();
+        renderer.join();
+        makeCurrent(true);
+    }
+
+    // Render thread: GL events from the main thread, then a frame of the
+    // latest snapshot. On demand, sleeps until a redraw or an event arrives.
+    void Engine::renderLoop() {
+        makeCurrent(true);
+        double last_time = StartTime;
+        bool idled = false;
+        RenderEvent event;
+        while (Rendering && !shouldClose()) {
+            while (RenderEvents.pop(event)) {
+                handleRenderEvent(event);
+            }
+            WakeRequested = false;
+            MeshManager::getInstance().upload();
+            ShaderManager::getInstance().update();
+            if (Redraw == RedrawMode::ON_DEMAND && !RedrawRequested && !Headless) {
+                auto woken = [this] {
+                    return RedrawRequested || WakeRequested || !Rendering ||
+                        !RenderEvents.empty();
+                };
+                double timeout = ShaderManager::getInstance().getIdleTimeout();
+                std::unique_lock<std::mutex> lock(RenderMutex);
+                if (timeout > 0.0) {
+                    RenderSignal.wait_for(lock, std::chrono::duration<double>(timeout),
+                        woken);
+                }
+                else {
+                    RenderSignal.wait(lock, woken);
+                }
+                idled = true;
+                continue;
+            }
+            // cleared before the snapshot is read, so a publish after this
+            // point always gets its own frame
+            RedrawRequested = false;
+            if (idled) {
+                last_time = getTime();
+            }
+            MGL_PROFILE_FRAME
+            MGL_PROFILE_SCOPE("Engine::render")
+            MGL_PROFILE_GPU_SCOPE("frame")
+            double time = getTime();
+            double elapsed_time = time - last_time;
+            last_time = time;
+            if (time > StartTime && !idled) {
+                std::lock_guard<std::mutex> lock(StatsMutex);
+                Stats.add(elapsed_time);
+            }
+            idled = false;
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            RingBuffer::getInstance().beginFrame();
+            GlApp->renderCallback(Window, elapsed_time);
+            RingBuffer::getInstance().endFrame();
+            present();
+            limitFrame(time);
+        }
+        makeCurrent(false);
+    }
+
+    void Engine::run() {
+        StartTime = getTime();
+        Frames = 0;
+        Stats.reset();
+        Running = true;
+        if (Threaded) {
+            runThreaded();
+        }
+        else {
+            runSingle();
+        }
+        if (Headless) {
+            double total_time = getTime() - StartTime;
+            std::cout << "headless: " << Frames << " frames in " << total_time
+                << " s [avg " << 1000.0 * total_time / Frames << " ms, p50 "
+                << Stats.getPercentile(50.0) << " ms, p95 "
+                << Stats.getPercentile(95.0) << " ms, p99 "
+                << Stats.getPercentile(99.0) << " ms, max " << Stats.getMax()
+                << " ms, " << Frames / total_time << " fps]" << std::endl;
+            if (HeadlessSnapshot) {
+                saveSnapshot(HeadlessSnapshot);
+            }
+            destroyFramebuffer();
+        }
+        Running = false;
+        RingBuffer::getInstance().destroy();
+        if (Window) {
+            glfwDestroyWindow(Window);
+            glfwTerminate();
+        }
+        else {
+            Surfaceless.destroy();
         }
-        glfwDestroyWindow(Window);
-        glfwTerminate();
     }
 
     ////////////////////////////////////////////////////////////////////////////////
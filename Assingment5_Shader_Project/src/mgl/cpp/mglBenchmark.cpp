@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Scene Benchmark Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglBenchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "./mglManager.hpp"
+#include "./mglRingBuffer.hpp"
+#include "./mglTransform.hpp"
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    typedef std::chrono::steady_clock Clock;
+
+    static double milliseconds(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // As a JSON string, quotes included; null, with no context, is "".
+    static std::string jsonString(const GLubyte* text) {
+        std::string out = "\"";
+        for (const char* c = reinterpret_cast<const char*>(text); c && *c; c++) {
+            if (*c == '"' || *c == '\\') {
+                out += '\\';
+                out += *c;
+            }
+            else if (static_cast<unsigned char>(*c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+                out += escaped;
+            }
+            else {
+                out += *c;
+            }
+        }
+        return out + "\"";
+    }
+
+    ////////////////////////////////////////////////////////////////////// BENCHMARK
+
+    Benchmark::Benchmark(const Config& config) : config(config) {}
+
+    void Benchmark::setupCamera(Scenegraph* scenegraph) {
+        float distance = 3.0f * config.spread;
+        scenegraph->setCameraView(glm::vec3(distance), glm::vec3(0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f));
+        scenegraph->setCameraPerspective(30.0f, 640.0f / 480.0f, 1.0f,
+            4.0f * distance);
+        scenegraph->setLight(glm::vec3(distance, distance, 0.0f));
+    }
+
+    Scenegraph* Benchmark::generate(size_t count, GLuint bindingpoint) {
+        std::mt19937 rng(config.seed);
+        std::discrete_distribution<size_t> mesh(config.meshWeights.begin(),
+            config.meshWeights.end());
+        std::discrete_distribution<size_t> shader(config.shaderWeights.begin(),
+            config.shaderWeights.end());
+        std::uniform_real_distribution<float> uniform(-config.spread, config.spread);
+        std::normal_distribution<float> normal(0.0f, config.spread / 3.0f);
+        std::uniform_real_distribution<float> scale(config.minScale, config.maxScale);
+        std::normal_distribution<float> axis(0.0f, 1.0f);
+
+        Scenegraph* scenegraph = new Scenegraph("benchmark");
+        scenegraph->createCamera(bindingpoint);
+        setupCamera(scenegraph);
+        if (!config.culling.empty()) {
+            scenegraph->setGpuDriven(ShaderManager::getInstance().get(config.culling));
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 t;
+            if (config.positions == Distribution::NORMAL) {
+                t = glm::vec3(normal(rng), normal(rng), normal(rng));
+            }
+            else {
+                t = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+            }
+            glm::quat q(1.0f, 0.0f, 0.0f, 0.0f);
+            if (config.rotate) {
+                q = glm::normalize(glm::quat(axis(rng), axis(rng), axis(rng), axis(rng)));
+            }
+
+            SceneNode* node = scenegraph->createNode();
+            node->setTransform(glm::vec3(scale(rng)), q, t);
+            node->setMesh(config.meshes[mesh(rng)]);
+            node->setShader(config.shaders[shader(rng)]);
+        }
+        return scenegraph;
+    }
+
+    void Benchmark::run(GLuint bindingpoint) {
+        results.clear();
+        for (size_t count : config.nodeCounts) {
+            Result result;
+            result.nodes = count;
+
+            Clock::time_point start = Clock::now();
+            Scenegraph* scenegraph = generate(count, bindingpoint);
+            result.generate = milliseconds(start, Clock::now());
+
+            if (config.saveAndLoad) {
+                start = Clock::now();
+                scenegraph->save();
+                result.save = milliseconds(start, Clock::now());
+
+                Scenegraph* loaded = new Scenegraph("benchmark");
+                loaded->createCamera(bindingpoint);
+                start = Clock::now();
+                loaded->load();
+                result.load = milliseconds(start, Clock::now());
+                std::remove(loaded->getPath().c_str());
+                delete loaded;
+            }
+
+            for (int frame = 0; frame < config.frames; frame++) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+                start = Clock::now();
+                scenegraph->update();
+                Clock::time_point updated = Clock::now();
+                scenegraph->cull();
+                Clock::time_point culled = Clock::now();
+                RingBuffer::getInstance().beginFrame();
+                scenegraph->submit();
+                RingBuffer::getInstance().endFrame();
+                glFinish();
+                Clock::time_point submitted = Clock::now();
+
+                result.update += milliseconds(start, updated) / config.frames;
+                result.cull += milliseconds(updated, culled) / config.frames;
+                result.submit += milliseconds(culled, submitted) / config.frames;
+            }
+            result.visible = scenegraph->getVisibleCount();
+            delete scenegraph;
+
+            std::cout << "benchmark: " << result.nodes << " nodes [update "
+                << result.update << " ms, cull " << result.cull << " ms, submit "
+                << result.submit << " ms]" << std::endl;
+            results.push_back(result);
+        }
+    }
+
+    void Benchmark::save(const std::string& filename) {
+        std::ofstream file(filename);
+        file << "{\n";
+        file << "  \"simd\": \"" << getSimdPathName(getSimdPath()) << "\",\n";
+        file << "  \"renderer\": " << jsonString(glGetString(GL_RENDERER)) << ",\n";
+        file << "  \"gpu_driven\": " << (config.culling.empty() ? "false" : "true") << ",\n";
+        file << "  \"frames\": " << config.frames << ",\n";
+        file << "  \"seed\": " << config.seed << ",\n";
+        file << "  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            file << "    { \"nodes\": " << r.nodes << ", \"visible\": " << r.visible
+                << ", \"generate_ms\": " << r.generate << ", \"save_ms\": " << r.save
+                << ", \"load_ms\": " << r.load << ", \"update_ms\": " << r.update
+                << ", \"cull_ms\": " << r.cull << ", \"submit_ms\": " << r.submit
+                << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        file << "  ]\n";
+        file << "}\n";
+        std::cout << "benchmark saved on: " << filename << std::endl;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
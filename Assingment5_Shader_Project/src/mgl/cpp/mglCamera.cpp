@@ -8,44 +8,52 @@
 
 #include "./mglCamera.hpp"
 
+#include <cstring>
+
 #include <glm/gtc/type_ptr.hpp>
 
+#include "./mglRingBuffer.hpp"
+
 namespace mgl {
 
     ///////////////////////////////////////////////////////////////////////// Camera
 
+    // No GL work happens before upload(), so cameras can be made and
+    // changed on a thread without a GL context.
     Camera::Camera(GLuint bindingpoint)
-        : ViewMatrix(glm::mat4(1.0f)), ProjectionMatrix(glm::mat4(1.0f)) {
-        glGenBuffers(1, &UboId);
-        glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-        glBufferData(GL_UNIFORM_BUFFER, sizeof(glm::mat4) * 2, 0, GL_STREAM_DRAW);
-        glBindBufferBase(GL_UNIFORM_BUFFER, bindingpoint, UboId);
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-    }
+        : BindingPoint(bindingpoint), ViewMatrix(glm::mat4(1.0f)),
+        ProjectionMatrix(glm::mat4(1.0f)) {}
 
-    Camera::~Camera() {
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
-        glDeleteBuffers(1, &UboId);
-    }
+    Camera::~Camera() {}
+
+    GLuint Camera::getBindingPoint() { return BindingPoint; }
 
     glm::mat4 Camera::getViewMatrix() { return ViewMatrix; }
 
     void Camera::setViewMatrix(const glm::mat4& viewmatrix) {
         ViewMatrix = viewmatrix;
-        glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4),
-            glm::value_ptr(ViewMatrix));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
     }
 
     glm::mat4 Camera::getProjectionMatrix() { return ProjectionMatrix; }
 
     void Camera::setProjectionMatrix(const glm::mat4& projectionmatrix) {
         ProjectionMatrix = projectionmatrix;
-        glBindBuffer(GL_UNIFORM_BUFFER, UboId);
-        glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4),
-            glm::value_ptr(ProjectionMatrix));
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // Once per frame, before drawing with this camera.
+    void Camera::upload() {
+        uploadCamera(BindingPoint, ViewMatrix, ProjectionMatrix);
+    }
+
+    void uploadCamera(GLuint bindingpoint, const glm::mat4& viewmatrix,
+        const glm::mat4& projectionmatrix) {
+        RingBuffer& ring = RingBuffer::getInstance();
+        RingBuffer::Allocation block = ring.allocate(sizeof(glm::mat4) * 2);
+        unsigned char* data = static_cast<unsigned char*>(block.data);
+        std::memcpy(data, glm::value_ptr(viewmatrix), sizeof(glm::mat4));
+        std::memcpy(data + sizeof(glm::mat4), glm::value_ptr(projectionmatrix),
+            sizeof(glm::mat4));
+        ring.bind(bindingpoint, block);
     }
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Surfaceless OpenGL Context
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglContext.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+// keeps Xlib, and its macros, out of the EGL headers
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace mgl {
+
+    //////////////////////////////////////////////////////////// SURFACELESS CONTEXT
+
+    SurfacelessContext::SurfacelessContext()
+        : Display(nullptr), Context(nullptr), Surface(nullptr) {}
+
+    SurfacelessContext::~SurfacelessContext() { destroy(); }
+
+#ifdef __linux__
+
+    static bool hasExtension(const char* extensions, const char* name) {
+        if (!extensions) return false;
+        size_t length = std::strlen(name);
+        for (const char* found = std::strstr(extensions, name); found;
+            found = std::strstr(found + length, name)) {
+            bool start = found == extensions || found[-1] == ' ';
+            bool end = found[length] == ' ' || found[length] == '\0';
+            if (start && end) return true;
+        }
+        return false;
+    }
+
+    // Reports why and leaves nothing behind.
+    static bool fail(SurfacelessContext* context, const char* reason) {
+        std::cerr << "surfaceless context: " << reason << " [EGL error 0x"
+            << std::hex << eglGetError() << std::dec << "]" << std::endl;
+        context->destroy();
+        return false;
+    }
+
+    bool SurfacelessContext::create(int major, int minor, bool debug, int width,
+        int height) {
+        // the default display would need a display server
+        const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (!hasExtension(client, "EGL_MESA_platform_surfaceless")) {
+            std::cerr << "surfaceless context: EGL_MESA_platform_surfaceless missing"
+                << std::endl;
+            return false;
+        }
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (!getPlatformDisplay) return fail(this, "no eglGetPlatformDisplayEXT");
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+            EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY) return fail(this, "no display");
+        if (!eglInitialize(display, nullptr, nullptr)) {
+            return fail(this, "eglInitialize failed");
+        }
+        Display = display;
+        if (!eglBindAPI(EGL_OPENGL_API)) return fail(this, "no desktop OpenGL");
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configs = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) ||
+            configs == 0) {
+            return fail(this, "no RGBA8 config with depth and stencil");
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION_KHR, major,
+            EGL_CONTEXT_MINOR_VERSION_KHR, minor,
+            EGL_CONTEXT_FLAGS_KHR, debug ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0,
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+            contextAttributes);
+        if (context == EGL_NO_CONTEXT) return fail(this, "eglCreateContext failed");
+        Context = context;
+
+        if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS),
+            "EGL_KHR_surfaceless_context")) {
+            const EGLint surfaceAttributes[] = {
+                EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE
+            };
+            EGLSurface surface = eglCreatePbufferSurface(display, config,
+                surfaceAttributes);
+            if (surface == EGL_NO_SURFACE) return fail(this, "no pbuffer");
+            Surface = surface;
+        }
+        if (!makeCurrent(true)) return fail(this, "eglMakeCurrent failed");
+        return true;
+    }
+
+    void SurfacelessContext::destroy() {
+        if (!Display) return;
+        eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (Surface) eglDestroySurface(Display, Surface);
+        if (Context) eglDestroyContext(Display, Context);
+        eglTerminate(Display);
+        Display = nullptr, Context = nullptr, Surface = nullptr;
+    }
+
+    // Current on the calling thread, or released from it.
+    bool SurfacelessContext::makeCurrent(bool current) {
+        EGLSurface surface = current && Surface ? Surface : EGL_NO_SURFACE;
+        return eglMakeCurrent(Display, surface, surface,
+            current ? Context : EGL_NO_CONTEXT) == EGL_TRUE;
+    }
+
+#else
+
+    bool SurfacelessContext::create(int major, int minor, bool debug, int width,
+        int height) {
+        return false;
+    }
+
+    void SurfacelessContext::destroy() {}
+
+    bool SurfacelessContext::makeCurrent(bool current) { return false; }
+
+#endif
+
+    bool SurfacelessContext::isCreated() { return Context != nullptr; }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
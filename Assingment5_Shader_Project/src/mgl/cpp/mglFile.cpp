@@ -0,0 +1,292 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File Utilities
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <direct.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace mgl {
+
+    //////////////////////////////////////////////////////////////////// MAPPED FILE
+
+#ifdef _WIN32
+
+    MappedFile::MappedFile()
+        : Data(nullptr), Size(0), File(INVALID_HANDLE_VALUE), Mapping(nullptr) {}
+
+    bool MappedFile::open(const std::string& filename) {
+        close();
+        File = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (File == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(File, &size) || size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (Mapping) {
+            Data = static_cast<const unsigned char*>(
+                MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!Data) {
+            close();
+            return false;
+        }
+        Size = static_cast<std::size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (Data) UnmapViewOfFile(Data);
+        if (Mapping) CloseHandle(Mapping);
+        if (File != INVALID_HANDLE_VALUE) CloseHandle(File);
+        Data = nullptr;
+        Size = 0;
+        File = INVALID_HANDLE_VALUE;
+        Mapping = nullptr;
+    }
+
+#else
+
+    MappedFile::MappedFile() : Data(nullptr), Size(0), File(-1) {}
+
+    bool MappedFile::open(const std::string& filename) {
+        close();
+        File = ::open(filename.c_str(), O_RDONLY);
+        if (File < 0) return false;
+        struct stat info;
+        if (fstat(File, &info) != 0 || info.st_size == 0) {
+            close();
+            return false;
+        }
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+        if (data == MAP_FAILED) {
+            close();
+            return false;
+        }
+        Data = static_cast<const unsigned char*>(data);
+        Size = static_cast<std::size_t>(info.st_size);
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (Data) munmap(const_cast<unsigned char*>(Data), Size);
+        if (File >= 0) ::close(File);
+        Data = nullptr;
+        Size = 0;
+        File = -1;
+    }
+
+#endif
+
+    MappedFile::~MappedFile() { close(); }
+
+    const unsigned char* MappedFile::data() { return Data; }
+
+    std::size_t MappedFile::size() { return Size; }
+
+    /////////////////////////////////////////////////////////////////// FILE WATCHER
+
+    static std::int64_t getModificationTime(const std::string& filename) {
+#ifdef _WIN32
+        struct _stat info;
+        if (_stat(filename.c_str(), &info) != 0) return 0;
+#else
+        struct stat info;
+        if (stat(filename.c_str(), &info) != 0) return 0;
+#endif
+        return (std::int64_t)info.st_mtime;
+    }
+
+    static std::string getDirectory(const std::string& filename) {
+        std::size_t slash = filename.find_last_of("/\\");
+        return slash == std::string::npos ? "." : filename.substr(0, slash);
+    }
+
+#ifdef __linux__
+
+    FileWatcher::FileWatcher() : Inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
+
+    FileWatcher::~FileWatcher() {
+        if (Inotify >= 0) ::close(Inotify);
+    }
+
+    void FileWatcher::watch(const std::string& filename) {
+        if (Files.count(filename)) return;
+        Files[filename] = getModificationTime(filename);
+        if (Inotify < 0) return;
+        std::string directory = getDirectory(filename);
+        int descriptor = inotify_add_watch(Inotify, directory.c_str(),
+            IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (descriptor >= 0) Directories[descriptor] = directory;
+    }
+
+    // Appends every changed file once, however many events it had.
+    bool FileWatcher::poll(std::vector<std::string>& changed) {
+        size_t first = changed.size();
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+            ssize_t length = Inotify < 0 ? -1 : read(Inotify, buffer, sizeof(buffer));
+            if (length <= 0) break;
+            for (char* p = buffer; p < buffer + length;) {
+                inotify_event* event = reinterpret_cast<inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                auto directory = Directories.find(event->wd);
+                if (directory == Directories.end() || event->len == 0) continue;
+                std::string filename = directory->second + "/" + event->name;
+                if (Files.count(filename) && std::find(changed.begin() + first,
+                    changed.end(), filename) == changed.end()) {
+                    changed.push_back(filename);
+                }
+            }
+        }
+        return changed.size() > first;
+    }
+
+#else
+
+    FileWatcher::FileWatcher() : LastCheck(std::chrono::steady_clock::now()) {}
+
+    FileWatcher::~FileWatcher() {}
+
+    void FileWatcher::watch(const std::string& filename) {
+        if (Files.count(filename)) return;
+        Files[filename] = getModificationTime(filename);
+    }
+
+    bool FileWatcher::poll(std::vector<std::string>& changed) {
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<double>(now - LastCheck).count() < CHECK_SECONDS) {
+            return false;
+        }
+        LastCheck = now;
+        size_t first = changed.size();
+        for (auto& file : Files) {
+            std::int64_t time = getModificationTime(file.first);
+            if (time != file.second) {
+                file.second = time;
+                changed.push_back(file.first);
+            }
+        }
+        return changed.size() > first;
+    }
+
+#endif
+
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    static const std::uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static const std::uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static const std::uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    static const std::uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static const std::uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    static inline std::uint64_t rotate(std::uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static inline std::uint64_t read64(const unsigned char* p) {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline std::uint64_t read32(const unsigned char* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+        return rotate(acc + input * PRIME2, 31) * PRIME1;
+    }
+
+    static inline std::uint64_t merge(std::uint64_t hash, std::uint64_t acc) {
+        return (hash ^ round(0, acc)) * PRIME1 + PRIME4;
+    }
+
+    std::uint64_t hashBytes(const void* data, std::size_t size, std::uint64_t seed) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+        std::uint64_t hash;
+        if (size >= 32) {
+            std::uint64_t v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2;
+            std::uint64_t v3 = seed, v4 = seed - PRIME1;
+            for (; p + 32 <= end; p += 32) {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+            hash = rotate(v1, 1) + rotate(v2, 7) + rotate(v3, 12) + rotate(v4, 18);
+            hash = merge(merge(merge(merge(hash, v1), v2), v3), v4);
+        }
+        else {
+            hash = seed + PRIME5;
+        }
+        hash += size;
+        for (; p + 8 <= end; p += 8) {
+            hash = rotate(hash ^ round(0, read64(p)), 27) * PRIME1 + PRIME4;
+        }
+        if (p + 4 <= end) {
+            hash = rotate(hash ^ (read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            hash = rotate(hash ^ (*p * PRIME5), 11) * PRIME1;
+        }
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    bool createDirectory(const std::string& path) {
+        for (std::size_t i = 1; i <= path.size(); i++) {
+            if (i < path.size() && path[i] != '/' && path[i] != '\\') continue;
+            std::string parent = path.substr(0, i);
+#ifdef _WIN32
+            _mkdir(parent.c_str());
+#else
+            mkdir(parent.c_str(), 0755);
+#endif
+        }
+#ifdef _WIN32
+        DWORD attributes = GetFileAttributesA(path.c_str());
+        return attributes != INVALID_FILE_ATTRIBUTES &&
+            (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Time Statistics
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglFrameStats.hpp"
+
+namespace mgl {
+
+    //////////////////////////////////////////////////////////////////// FRAME STATS
+
+    FrameStats::FrameStats() { reset(); }
+
+    void FrameStats::reset() {
+        next = 0, count = 0;
+        sum = 0.0;
+        for (unsigned int& b : histogram) b = 0;
+    }
+
+    size_t FrameStats::bucket(double ms) {
+        size_t b = static_cast<size_t>(ms / BUCKET_WIDTH);
+        return b < BUCKETS ? b : BUCKETS - 1;
+    }
+
+    void FrameStats::add(double seconds) {
+        double ms = 1000.0 * seconds;
+        if (count == WINDOW) {
+            // the oldest sample leaves the window
+            sum -= samples[next];
+            histogram[bucket(samples[next])]--;
+        }
+        else {
+            count++;
+        }
+        samples[next] = ms;
+        sum += ms;
+        histogram[bucket(ms)]++;
+        next = (next + 1) % WINDOW;
+    }
+
+    size_t FrameStats::getCount() const { return count; }
+
+    double FrameStats::getMean() const { return count ? sum / count : 0.0; }
+
+    double FrameStats::getMin() const {
+        double min = count ? samples[0] : 0.0;
+        for (size_t i = 1; i < count; i++) {
+            min = samples[i] < min ? samples[i] : min;
+        }
+        return min;
+    }
+
+    double FrameStats::getMax() const {
+        double max = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            max = samples[i] > max ? samples[i] : max;
+        }
+        return max;
+    }
+
+    // Upper edge of the bucket holding the p-th percentile, so the result
+    // is within BUCKET_WIDTH of the exact value (frames over the histogram
+    // range report the range limit).
+    double FrameStats::getPercentile(double p) const {
+        if (count == 0) return 0.0;
+        size_t rank = static_cast<size_t>(p / 100.0 * (count - 1)) + 1;
+        size_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; b++) {
+            seen += histogram[b];
+            if (seen >= rank) return (b + 1) * BUCKET_WIDTH;
+        }
+        return BUCKETS * BUCKET_WIDTH;
+    }
+
+    const unsigned int* FrameStats::getHistogram() const { return histogram; }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
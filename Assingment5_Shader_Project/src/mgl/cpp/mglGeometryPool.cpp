@@ -0,0 +1,443 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Shared Geometry Pool Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglGeometryPool.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace mgl {
+
+    //////////////////////////////////////////////////////////////// RANGE ALLOCATOR
+
+    RangeAllocator::RangeAllocator() {
+        Capacity = 0;
+        UsedSize = 0;
+    }
+
+    void RangeAllocator::reset(size_t capacity) {
+        FreeByOffset.clear();
+        FreeBySize.clear();
+        Used.clear();
+        Capacity = capacity;
+        UsedSize = 0;
+        if (capacity > 0) insertFree(0, capacity);
+    }
+
+    // New space is merged with a free block ending at the old capacity.
+    void RangeAllocator::grow(size_t capacity) {
+        if (capacity <= Capacity) return;
+        size_t offset = Capacity, size = capacity - Capacity;
+        auto last = FreeByOffset.lower_bound(Capacity);
+        if (last != FreeByOffset.begin()) {
+            --last;
+            if (last->first + last->second == Capacity) {
+                offset = last->first;
+                size += last->second;
+                eraseFree(last);
+            }
+        }
+        insertFree(offset, size);
+        Capacity = capacity;
+    }
+
+    // Empty ranges take one unit so every allocation has its own offset.
+    size_t RangeAllocator::allocate(size_t size) {
+        if (size == 0) size = 1;
+        auto fit = FreeBySize.lower_bound(std::make_pair(size, size_t(0)));
+        if (fit == FreeBySize.end()) return NONE;
+        size_t offset = fit->second, available = fit->first;
+        eraseFree(FreeByOffset.find(offset));
+        if (available > size) insertFree(offset + size, available - size);
+        Used[offset] = size;
+        UsedSize += size;
+        return offset;
+    }
+
+    void RangeAllocator::free(size_t offset) {
+        auto used = Used.find(offset);
+        if (used == Used.end()) return;
+        size_t size = used->second;
+        Used.erase(used);
+        UsedSize -= size;
+
+        auto next = FreeByOffset.lower_bound(offset);
+        if (next != FreeByOffset.end() && offset + size == next->first) {
+            size += next->second;
+            eraseFree(next);
+        }
+        auto previous = FreeByOffset.lower_bound(offset);
+        if (previous != FreeByOffset.begin()) {
+            --previous;
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                eraseFree(previous);
+            }
+        }
+        insertFree(offset, size);
+    }
+
+    size_t RangeAllocator::getCapacity() { return Capacity; }
+
+    size_t RangeAllocator::getUsed() { return UsedSize; }
+
+    size_t RangeAllocator::getLargestFree() {
+        return FreeBySize.empty() ? 0 : FreeBySize.rbegin()->first;
+    }
+
+    size_t RangeAllocator::getFreeBlocks() { return FreeByOffset.size(); }
+
+    void RangeAllocator::insertFree(size_t offset, size_t size) {
+        FreeByOffset[offset] = size;
+        FreeBySize.insert(std::make_pair(size, offset));
+    }
+
+    void RangeAllocator::eraseFree(std::map<size_t, size_t>::iterator block) {
+        FreeBySize.erase(std::make_pair(block->second, block->first));
+        FreeByOffset.erase(block);
+    }
+
+    ////////////////////////////////////////////////////////////////// GEOMETRY POOL
+
+    GeometryPool::GeometryPool() {
+        BoundVao = 0;
+        Immutable = false;
+        Pulling = false;
+        LayoutBuffer = 0;
+        LayoutsUploaded = 0;
+        LayoutVersion = 0;
+    }
+
+    // GL objects go with the context.
+    GeometryPool::~GeometryPool() {}
+
+    GeometryPool& GeometryPool::getInstance() {
+        static GeometryPool instance;
+        return instance;
+    }
+
+    // Buffers are only written through the copy targets, so the element
+    // array binding of whatever VAO is bound is never touched.
+    GLuint GeometryPool::createBuffer(size_t bytes) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if (Immutable) {
+            glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, 0, GL_DYNAMIC_STORAGE_BIT);
+        }
+        else {
+            glBufferData(GL_COPY_WRITE_BUFFER, bytes, 0, GL_STATIC_DRAW);
+        }
+        return buffer;
+    }
+
+    GLuint GeometryPool::resizeBuffer(GLuint buffer, size_t copyBytes, size_t bytes) {
+        GLuint resized = createBuffer(bytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, copyBytes);
+        glDeleteBuffers(1, &buffer);
+        return resized;
+    }
+
+    void GeometryPool::attachBuffers(Arena& arena) {
+        glBindVertexArray(arena.vao);
+        BoundVao = arena.vao;
+        glBindVertexBuffer(0, arena.vertexBuffer, 0, arena.stride);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer);
+    }
+
+    // Only takes effect before the first allocation; the arenas already
+    // made keep their layout.
+    void GeometryPool::setVertexPulling(bool pulling) {
+        if (!Arenas.empty()) {
+            std::cerr << "WARNING: vertex pulling must be set before the first mesh."
+                << std::endl;
+            return;
+        }
+        Pulling = pulling;
+    }
+
+    bool GeometryPool::isVertexPulling() { return Pulling; }
+
+    // Formats are told apart by their VAO setup, which is one function per
+    // VertexFormat.
+    GLuint GeometryPool::getLayout(const VertexLayout& layout) {
+        for (size_t i = 0; i < Layouts.size(); i++) {
+            if (Layouts[i].setup == layout.setup) return (GLuint)i;
+        }
+        Layouts.push_back(layout);
+        return (GLuint)(Layouts.size() - 1);
+    }
+
+    // When pulling, every layout goes to arena 0, counted in words and
+    // without attributes.
+    size_t GeometryPool::getArena(GLuint layout) {
+        if (Pulling && !Arenas.empty()) return 0;
+        for (size_t i = 0; i < Arenas.size(); i++) {
+            if (Arenas[i]->layout == layout) return i;
+        }
+        Immutable = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+
+        std::unique_ptr<Arena> arena(new Arena);
+        arena->layout = layout;
+        arena->stride = Pulling ? (GLsizei)sizeof(GLuint) : Layouts[layout].stride;
+        // words for as many vertices of 32 bytes
+        size_t vertices = Pulling ? INITIAL_VERTICES * 8 : INITIAL_VERTICES;
+        arena->vertices.reset(vertices);
+        arena->indices.reset(INITIAL_INDICES);
+        arena->vertexBuffer = createBuffer(vertices * arena->stride);
+        arena->indexBuffer = createBuffer(INITIAL_INDICES * sizeof(unsigned int));
+        glGenVertexArrays(1, &arena->vao);
+        attachBuffers(*arena);
+        if (!Pulling) Layouts[layout].setup(0, 0);
+        Arenas.push_back(std::move(arena));
+        return Arenas.size() - 1;
+    }
+
+    // Doubles the buffer, or more, if its largest free block can not take
+    // count; after a defragment that block is at the end and grows with it.
+    void GeometryPool::growRange(Arena& arena, RangeAllocator& range,
+        GLuint& buffer, size_t unit, size_t count) {
+        if (range.getLargestFree() >= std::max(count, size_t(1))) return;
+        size_t capacity = std::max(2 * range.getCapacity(), range.getCapacity() + count);
+        buffer = resizeBuffer(buffer, range.getCapacity() * unit, capacity * unit);
+        range.grow(capacity);
+        attachBuffers(arena);
+    }
+
+    // When either range does not fit, the arena is packed first, since the
+    // space may be there but scattered, and only then grown.
+    GeometryAllocation* GeometryPool::allocate(const VertexLayout& layout,
+        size_t vertexCount, size_t indexCount, std::uint64_t key) {
+        GLuint layoutIndex = getLayout(layout);
+        size_t index = getArena(layoutIndex);
+        Arena& arena = *Arenas[index];
+        size_t vertexUnits = layout.stride / arena.stride;
+        size_t units = vertexCount * vertexUnits;
+        size_t firstVertex = arena.vertices.allocate(units);
+        size_t firstIndex = arena.indices.allocate(indexCount);
+        if (firstVertex == RangeAllocator::NONE || firstIndex == RangeAllocator::NONE) {
+            if (firstVertex != RangeAllocator::NONE) arena.vertices.free(firstVertex);
+            if (firstIndex != RangeAllocator::NONE) arena.indices.free(firstIndex);
+            defragment(arena);
+            growRange(arena, arena.vertices, arena.vertexBuffer, arena.stride, units);
+            growRange(arena, arena.indices, arena.indexBuffer, sizeof(unsigned int),
+                indexCount);
+            firstVertex = arena.vertices.allocate(units);
+            firstIndex = arena.indices.allocate(indexCount);
+        }
+
+        std::unique_ptr<GeometryAllocation> allocation(new GeometryAllocation);
+        allocation->arena = index;
+        allocation->layout = layoutIndex;
+        allocation->vertexUnits = vertexUnits;
+        allocation->firstVertex = firstVertex;
+        allocation->vertexCount = vertexCount;
+        allocation->firstIndex = firstIndex;
+        allocation->indexCount = indexCount;
+        allocation->key = key;
+        if (key) Keys[key] = allocation.get();
+        arena.allocations.push_back(std::move(allocation));
+        return arena.allocations.back().get();
+    }
+
+    // Another reference to the allocation with this content key, if one
+    // with the same format and sizes exists; the key is a hash, so the
+    // sizes guard against the odd collision.
+    GeometryAllocation* GeometryPool::acquire(const VertexLayout& layout,
+        std::uint64_t key, size_t vertexCount, size_t indexCount) {
+        if (!key) return nullptr;
+        auto found = Keys.find(key);
+        if (found == Keys.end()) return nullptr;
+        GeometryAllocation* allocation = found->second;
+        if (Layouts[allocation->layout].setup != layout.setup ||
+            allocation->vertexCount != vertexCount ||
+            allocation->indexCount != indexCount) {
+            return nullptr;
+        }
+        allocation->references++;
+        return allocation;
+    }
+
+    void GeometryPool::upload(GeometryAllocation* allocation, const void* vertices,
+        const unsigned int* indices) {
+        Arena& arena = *Arenas[allocation->arena];
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation->firstVertex * arena.stride,
+            allocation->vertexCount * allocation->vertexUnits * arena.stride, vertices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, arena.indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER,
+            allocation->firstIndex * sizeof(unsigned int),
+            allocation->indexCount * sizeof(unsigned int), indices);
+    }
+
+    void GeometryPool::free(GeometryAllocation* allocation) {
+        if (--allocation->references > 0) return;
+        // A colliding key may since have been taken by another allocation.
+        auto found = Keys.find(allocation->key);
+        if (found != Keys.end() && found->second == allocation) Keys.erase(found);
+        Arena& arena = *Arenas[allocation->arena];
+        arena.vertices.free(allocation->firstVertex);
+        arena.indices.free(allocation->firstIndex);
+        for (size_t i = 0; i < arena.allocations.size(); i++) {
+            if (arena.allocations[i].get() == allocation) {
+                std::swap(arena.allocations[i], arena.allocations.back());
+                arena.allocations.pop_back();
+                break;
+            }
+        }
+    }
+
+    // Meshes leave their arena VAO bound; it is only rebound when the
+    // next mesh lives in another arena.
+    void GeometryPool::bind(const GeometryAllocation* allocation) {
+        bindArena(allocation->arena);
+    }
+
+    void GeometryPool::bindArena(size_t arena) {
+        GLuint vao = Arenas[arena]->vao;
+        if (vao != BoundVao) {
+            glBindVertexArray(vao);
+            BoundVao = vao;
+        }
+    }
+
+    // The words of the pulling arena and the table of every layout it holds,
+    // as read by phong-pull-vs.glsl; the pulling arena VAO is bound to draw.
+    void GeometryPool::bindStorage(GLuint vertexBinding, GLuint layoutBinding) {
+        if (!Pulling || Arenas.empty()) return;
+        if (!LayoutBuffer) glGenBuffers(1, &LayoutBuffer);
+        if (LayoutsUploaded != Layouts.size()) {
+            std::vector<LayoutData> table(Layouts.size());
+            for (size_t i = 0; i < Layouts.size(); i++) {
+                table[i] = LayoutData();
+                table[i].stride[0] = Layouts[i].stride / sizeof(GLuint);
+                for (GLuint l = 0; l < VertexLayout::MAX_ATTRIBUTES; l++) {
+                    const VertexLayout::Attribute& attribute = Layouts[i].attributes[l];
+                    table[i].attributes[l][0] = attribute.offset;
+                    table[i].attributes[l][1] = attribute.type;
+                    table[i].attributes[l][2] = attribute.components;
+                    table[i].attributes[l][3] = attribute.normalized;
+                }
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, LayoutBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, sizeof(LayoutData) * table.size(),
+                table.data(), GL_STATIC_DRAW);
+            LayoutsUploaded = Layouts.size();
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, vertexBinding, Arenas[0]->vertexBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, layoutBinding, LayoutBuffer);
+        bindArena(0);
+    }
+
+    // Copies every allocation, in offset order, to the front of new buffers
+    // of the same size; the old buffers are dropped once the copies are
+    // queued.
+    void GeometryPool::defragment(Arena& arena) {
+        std::vector<GeometryAllocation*> order;
+        for (std::unique_ptr<GeometryAllocation>& allocation : arena.allocations) {
+            order.push_back(allocation.get());
+        }
+
+        std::sort(order.begin(), order.end(),
+            [](GeometryAllocation* a, GeometryAllocation* b) {
+                return a->firstVertex < b->firstVertex;
+            });
+        GLuint vertexBuffer = createBuffer(arena.vertices.getCapacity() * arena.stride);
+        glBindBuffer(GL_COPY_READ_BUFFER, arena.vertexBuffer);
+        arena.vertices.reset(arena.vertices.getCapacity());
+        for (GeometryAllocation* allocation : order) {
+            size_t units = allocation->vertexCount * allocation->vertexUnits;
+            size_t offset = arena.vertices.allocate(units);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                allocation->firstVertex * arena.stride, offset * arena.stride,
+                units * arena.stride);
+            allocation->firstVertex = offset;
+        }
+        glDeleteBuffers(1, &arena.vertexBuffer);
+        arena.vertexBuffer = vertexBuffer;
+
+        std::sort(order.begin(), order.end(),
+            [](GeometryAllocation* a, GeometryAllocation* b) {
+                return a->firstIndex < b->firstIndex;
+            });
+        GLuint indexBuffer =
+            createBuffer(arena.indices.getCapacity() * sizeof(unsigned int));
+        glBindBuffer(GL_COPY_READ_BUFFER, arena.indexBuffer);
+        arena.indices.reset(arena.indices.getCapacity());
+        for (GeometryAllocation* allocation : order) {
+            size_t offset = arena.indices.allocate(allocation->indexCount);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                allocation->firstIndex * sizeof(unsigned int),
+                offset * sizeof(unsigned int),
+                allocation->indexCount * sizeof(unsigned int));
+            allocation->firstIndex = offset;
+        }
+        glDeleteBuffers(1, &arena.indexBuffer);
+        arena.indexBuffer = indexBuffer;
+
+        attachBuffers(arena);
+        LayoutVersion++;
+    }
+
+    // Call after unloading meshes; arenas with a single free block are
+    // already packed.
+    void GeometryPool::defragment() {
+        for (std::unique_ptr<Arena>& arena : Arenas) {
+            if (arena->vertices.getFreeBlocks() > 1 || arena->indices.getFreeBlocks() > 1) {
+                defragment(*arena);
+            }
+        }
+    }
+
+    size_t GeometryPool::getLayoutVersion() { return LayoutVersion; }
+
+    GeometryPoolStats GeometryPool::getStats() {
+        GeometryPoolStats stats;
+        size_t free = 0, largest = 0;
+        for (std::unique_ptr<Arena>& arena : Arenas) {
+            RangeAllocator& v = arena->vertices;
+            RangeAllocator& i = arena->indices;
+            stats.arenas++;
+            stats.allocations += arena->allocations.size();
+            for (std::unique_ptr<GeometryAllocation>& allocation : arena->allocations) {
+                size_t shared = allocation->references - 1;
+                stats.sharedMeshes += shared;
+                stats.sharedBytes += shared * (allocation->vertexCount *
+                    allocation->vertexUnits * arena->stride +
+                    allocation->indexCount * sizeof(unsigned int));
+            }
+            stats.vertexBytes += v.getUsed() * arena->stride;
+            stats.vertexCapacity += v.getCapacity() * arena->stride;
+            stats.indexBytes += i.getUsed() * sizeof(unsigned int);
+            stats.indexCapacity += i.getCapacity() * sizeof(unsigned int);
+            stats.freeBlocks += v.getFreeBlocks() + i.getFreeBlocks();
+            free += (v.getCapacity() - v.getUsed()) * arena->stride +
+                (i.getCapacity() - i.getUsed()) * sizeof(unsigned int);
+            largest += v.getLargestFree() * arena->stride +
+                i.getLargestFree() * sizeof(unsigned int);
+        }
+        if (free > 0) stats.fragmentation = 1.0 - (double)largest / free;
+        return stats;
+    }
+
+    void GeometryPool::printStats() {
+        GeometryPoolStats stats = getStats();
+        std::cout << "Geometry pool [" << stats.arenas << " arena(s), "
+            << stats.allocations << " allocation(s), vertices " << stats.vertexBytes / 1024
+            << "/" << stats.vertexCapacity / 1024 << " KB, indices "
+            << stats.indexBytes / 1024 << "/" << stats.indexCapacity / 1024
+            << " KB, " << stats.freeBlocks << " free block(s), fragmentation "
+            << 100.0 * stats.fragmentation << "%, " << stats.sharedMeshes
+            << " shared mesh(es) saving " << stats.sharedBytes / 1024 << " KB]"
+            << std::endl;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,334 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// GPU-Driven Scene Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglGpuScene.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "./mglConventions.hpp"
+#include "./mglGeometryPool.hpp"
+#include "./mglMesh.hpp"
+#include "./mglProfiler.hpp"
+#include "./mglShader.hpp"
+#include "./mglSnapshot.hpp"
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    // std430 layout of the Objects block; only ever written by cull-cs.glsl
+    struct ObjectData {
+        glm::mat4 model;
+        glm::vec4 normal[3];
+        glm::vec3 color;
+        GLuint layout;
+    };
+
+    // Ranges are uploaded as they are, as vec4 sphere, vec4 cone, uvec4 draw.
+    static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 Range");
+
+    // Replaces the contents of buffer. Storage is never empty, so every
+    // buffer can be bound even before there is anything in it.
+    static void writeBuffer(GLuint buffer, size_t bytes, const void* data) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, std::max<size_t>(bytes, 16), nullptr,
+            GL_DYNAMIC_DRAW);
+        if (bytes > 0 && data) {
+            glBufferSubData(GL_COPY_WRITE_BUFFER, 0, bytes, data);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////// GPU SCENE
+
+    bool GpuScene::isSupported() {
+        return GLEW_VERSION_4_6 != 0;
+    }
+
+    GpuScene::GpuScene(ShaderProgram* culling) : Culling(culling) {
+        NodeCapacity = 0;
+        MeshesChanged = false;
+        LayoutVersion = GeometryPool::getInstance().getLayoutVersion();
+        BatchesChanged = true;
+        CommandCapacity = 0;
+
+        glGenBuffers(1, &ObjectBuffer);
+        glGenBuffers(1, &NodeBuffer);
+        glGenBuffers(1, &MeshBuffer);
+        glGenBuffers(1, &RangeBuffer);
+        glGenBuffers(1, &BatchBuffer);
+        glGenBuffers(1, &CommandBuffer);
+        glGenBuffers(1, &CountBuffer);
+        writeBuffer(ObjectBuffer, 0, nullptr);
+        writeBuffer(NodeBuffer, 0, nullptr);
+        writeBuffer(MeshBuffer, 0, nullptr);
+        writeBuffer(RangeBuffer, 0, nullptr);
+        writeBuffer(CommandBuffer, 0, nullptr);
+    }
+
+    GpuScene::~GpuScene() {
+        glDeleteBuffers(1, &ObjectBuffer);
+        glDeleteBuffers(1, &NodeBuffer);
+        glDeleteBuffers(1, &MeshBuffer);
+        glDeleteBuffers(1, &RangeBuffer);
+        glDeleteBuffers(1, &BatchBuffer);
+        glDeleteBuffers(1, &CommandBuffer);
+        glDeleteBuffers(1, &CountBuffer);
+    }
+
+    // Nodes past count are dropped; new nodes draw nothing until set.
+    void GpuScene::resize(size_t count) {
+        for (size_t i = count; i < Nodes.size(); i++) {
+            retire(i);
+        }
+        NodeData empty = NodeData();
+        empty.mesh = NO_MESH;
+        for (size_t i = Nodes.size(); i < count; i++) {
+            Changed.push_back(i);
+        }
+        Nodes.resize(count, empty);
+    }
+
+    // Nodes without a mesh or shader, or whose mesh is not uploaded yet,
+    // are kept but never drawn.
+    void GpuScene::setNode(size_t index, const glm::vec3& translation,
+        const glm::quat& rotation, const glm::vec3& scaling,
+        const glm::vec3& color, Mesh* mesh, ShaderProgram* shader) {
+        GLuint meshIndex = NO_MESH, batchIndex = 0;
+        if (mesh && shader && mesh->getGeometry()) {
+            meshIndex = getMesh(mesh);
+            batchIndex = getBatch(mesh, shader);
+        }
+
+        NodeData& node = Nodes[index];
+        if (node.mesh != meshIndex || node.batch != batchIndex) {
+            retire(index);
+            if (meshIndex != NO_MESH) {
+                Batch& batch = Batches[batchIndex];
+                batch.nodes++;
+                batch.capacity += MeshCapacity[meshIndex];
+                BatchesChanged = true;
+            }
+            node.mesh = meshIndex;
+            node.batch = batchIndex;
+        }
+        node.translation = glm::vec4(translation, 1.0f);
+        node.rotation = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+        node.scaling = glm::vec4(scaling, 1.0f);
+        node.color = glm::vec4(color, 1.0f);
+        Changed.push_back(index);
+    }
+
+    void GpuScene::retire(size_t index) {
+        NodeData& node = Nodes[index];
+        if (node.mesh == NO_MESH) return;
+        Batch& batch = Batches[node.batch];
+        batch.nodes--;
+        batch.capacity -= MeshCapacity[node.mesh];
+        BatchesChanged = true;
+        node.mesh = NO_MESH;
+    }
+
+    GLuint GpuScene::getMesh(Mesh* mesh) {
+        auto found = MeshIndex.find(mesh);
+        if (found != MeshIndex.end()) return found->second;
+
+        GLuint index = (GLuint)MeshList.size();
+        MeshIndex[mesh] = index;
+        MeshList.push_back(mesh);
+        MeshRecords.push_back(MeshRecord());
+        MeshCapacity.push_back(0);
+        buildMesh(index);
+        MeshesChanged = true;
+        return index;
+    }
+
+    // Levels in another arena or vertex format, or quantized in other
+    // bounds, can not share the batch and Object of the mesh and are left
+    // out.
+    void GpuScene::buildMesh(GLuint index) {
+        Mesh* mesh = MeshList[index];
+        MeshRecord& record = MeshRecords[index];
+        record = MeshRecord();
+        record.positionMatrix = mesh->getPositionMatrix();
+        record.sphere = glm::vec4(mesh->getCenter(), mesh->getRadius());
+        record.layout = mesh->getGeometry()->layout;
+
+        std::vector<MeshLod> levels(1, MeshLod{ mesh, 0.0f });
+        levels.insert(levels.end(), mesh->getLods().begin(), mesh->getLods().end());
+        GLuint capacity = 0;
+        for (const MeshLod& level : levels) {
+            if (record.lodCount == MAX_LODS) break;
+            const GeometryAllocation* geometry = level.mesh->getGeometry();
+            if (!geometry || geometry->arena != mesh->getGeometry()->arena ||
+                geometry->layout != record.layout ||
+                level.mesh->getPositionMatrix() != record.positionMatrix) {
+                std::cerr << "WARNING: level of detail left out of the GPU scene."
+                    << std::endl;
+                continue;
+            }
+            GLuint l = record.lodCount++;
+            record.lodScreenSize[l] = level.screenSize;
+            record.firstRange[l] = (GLuint)Ranges.size();
+            level.mesh->appendDrawRanges(Ranges);
+            record.rangeCount[l] = (GLuint)Ranges.size() - record.firstRange[l];
+            capacity = std::max(capacity, record.rangeCount[l]);
+        }
+        MeshCapacity[index] = capacity;
+    }
+
+    GLuint GpuScene::getBatch(Mesh* mesh, ShaderProgram* shader) {
+        std::pair<size_t, ShaderProgram*> key(mesh->getGeometry()->arena, shader);
+        auto found = BatchIndex.find(key);
+        if (found != BatchIndex.end()) return found->second;
+
+        GLuint index = (GLuint)Batches.size();
+        BatchIndex[key] = index;
+        Batch batch = { key.first, shader, 0, 0, 0 };
+        Batches.push_back(batch);
+        BatchesChanged = true;
+        return index;
+    }
+
+    // Ranges hold pool offsets, so they are rebuilt after the pool moves
+    // allocations.
+    void GpuScene::uploadMeshes() {
+        size_t version = GeometryPool::getInstance().getLayoutVersion();
+        if (version != LayoutVersion) {
+            Ranges.clear();
+            for (GLuint i = 0; i < MeshList.size(); i++) {
+                buildMesh(i);
+            }
+            LayoutVersion = version;
+            MeshesChanged = true;
+        }
+        if (!MeshesChanged) return;
+        writeBuffer(MeshBuffer, sizeof(MeshRecord) * MeshRecords.size(),
+            MeshRecords.data());
+        writeBuffer(RangeBuffer, sizeof(Meshlet) * Ranges.size(), Ranges.data());
+        MeshesChanged = false;
+    }
+
+    // Batches take consecutive ranges of the command buffer, each as long
+    // as the most commands its nodes can append; the counts the culling
+    // pass appends at are one per batch.
+    void GpuScene::uploadBatches() {
+        std::vector<GLuint> offsets(Batches.size());
+        size_t total = 0;
+        for (size_t i = 0; i < Batches.size(); i++) {
+            Batches[i].offset = total;
+            offsets[i] = (GLuint)total;
+            total += Batches[i].capacity;
+        }
+        if (total > CommandCapacity) {
+            CommandCapacity = std::max(total, 2 * CommandCapacity);
+            writeBuffer(CommandBuffer, sizeof(DrawCommand) * CommandCapacity, nullptr);
+        }
+        writeBuffer(BatchBuffer, sizeof(GLuint) * offsets.size(), offsets.data());
+        writeBuffer(CountBuffer, sizeof(GLuint) * offsets.size(), nullptr);
+        BatchesChanged = false;
+    }
+
+    // Changed nodes go in runs of consecutive indices; when the buffers
+    // grow every node goes at once.
+    void GpuScene::uploadNodes() {
+        if (Nodes.size() > NodeCapacity) {
+            NodeCapacity = std::max(Nodes.size(), 2 * NodeCapacity);
+            writeBuffer(NodeBuffer, sizeof(NodeData) * NodeCapacity, nullptr);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(NodeData) * Nodes.size(),
+                Nodes.data());
+            writeBuffer(ObjectBuffer, sizeof(ObjectData) * NodeCapacity, nullptr);
+            Changed.clear();
+            return;
+        }
+
+        std::sort(Changed.begin(), Changed.end());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, NodeBuffer);
+        for (size_t i = 0; i < Changed.size();) {
+            size_t first = Changed[i], last = first;
+            while (++i < Changed.size() && Changed[i] <= last + 1) {
+                last = Changed[i];
+            }
+            // sorted, so every later index is gone too
+            if (first >= Nodes.size()) break;
+            last = std::min(last, Nodes.size() - 1);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(NodeData) * first,
+                sizeof(NodeData) * (last - first + 1), &Nodes[first]);
+        }
+        Changed.clear();
+    }
+
+    void GpuScene::cull(const glm::mat4& view, const glm::mat4& projection,
+        const glm::vec3& eye) {
+        MGL_PROFILE_SCOPE("GpuScene::cull")
+        uploadMeshes();
+        if (BatchesChanged) uploadBatches();
+        uploadNodes();
+        if (Nodes.empty()) return;
+
+        GLuint zero = 0;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, CountBuffer);
+        glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+            GL_UNSIGNED_INT, &zero);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, ObjectBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, NODE_BINDING, NodeBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, MeshBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RANGE_BINDING, RangeBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_BINDING, BatchBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, CommandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, CountBuffer);
+
+        Culling->bind();
+        glm::mat4 viewProjection = projection * view;
+        GLuint nodeCount = (GLuint)Nodes.size();
+        Culling->setUniforms({
+            { VIEW_PROJECTION_MATRIX, viewProjection },
+            { EYE_POSITION, eye },
+            // cot(fovy / 2): sphere radius over distance to screen size
+            { PROJECTION_SCALE, projection[1][1] },
+            { NODE_COUNT, nodeCount } });
+        glDispatchCompute(
+            (GLuint)((Nodes.size() + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+        Culling->unbind();
+
+        // commands and counts feed the draws, objects the vertex shaders
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void GpuScene::draw(FrameConstants& frame) {
+        MGL_PROFILE_SCOPE("GpuScene::draw")
+        if (Nodes.empty()) return;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, CommandBuffer);
+        glBindBuffer(GL_PARAMETER_BUFFER, CountBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BINDING, ObjectBuffer);
+        GeometryPool& pool = GeometryPool::getInstance();
+        pool.bindStorage(VERTEX_BINDING, LAYOUT_BINDING);
+        for (size_t i = 0; i < Batches.size(); i++) {
+            const Batch& batch = Batches[i];
+            if (batch.capacity == 0) continue;
+            batch.shader->bind();
+            bindFrameConstants(batch.shader, frame);
+            pool.bindArena(batch.arena);
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT,
+                reinterpret_cast<void*>(sizeof(DrawCommand) * batch.offset),
+                (GLintptr)(sizeof(GLuint) * i), (GLsizei)batch.capacity,
+                sizeof(DrawCommand));
+            batch.shader->unbind();
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    }
+
+    size_t GpuScene::getNodeCount() { return Nodes.size(); }
+
+    size_t GpuScene::getBatchCount() { return Batches.size(); }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,250 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Manager Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglManager.hpp"
+
+#include <algorithm>
+
+#include "./mglApp.hpp"
+#include "./mglShaderVariants.hpp"
+
+namespace mgl {
+
+    ///////////////////////////////////////////////////////////////// SHADER MANAGER
+
+    ShaderManager& ShaderManager::getInstance() {
+        static ShaderManager instance;
+        return instance;
+    }
+
+    ShaderManager::ShaderManager() {}
+
+    void ShaderManager::add(const std::string& key, ShaderProgram* shader) {
+        Manager<ShaderProgram>::add(key, shader);
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        if (!watcher) return;
+        for (const std::string& filename : shader->getFilenames()) {
+            watcher->watch(filename);
+        }
+    }
+
+    // Kept under their name, which get() with features looks up first.
+    void ShaderManager::addVariants(ShaderVariants* shaders) {
+        variants[shaders->getName()] = shaders;
+    }
+
+    // A key without variants is a program, whatever the features.
+    ShaderProgram* ShaderManager::get(const std::string& key, unsigned int features) {
+        auto found = variants.find(key);
+        if (found == variants.end()) return get(key);
+        return found->second->get(features);
+    }
+
+    // Lets the driver use as many compiler threads as it likes.
+    void ShaderManager::watch() {
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        if (watcher) return;
+        watcher.reset(new FileWatcher());
+        for (auto& o : objects) {
+            for (const std::string& filename : o.second->getFilenames()) {
+                watcher->watch(filename);
+            }
+        }
+        if (GLEW_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+
+    // Context thread only. A file changed again while its program is still
+    // compiling starts that program over. Programs are reloaded once the
+    // lock is released, so the main thread never waits on the compiler.
+    void ShaderManager::update() {
+        std::vector<std::pair<std::string, ShaderProgram*>> reloads;
+        {
+            std::lock_guard<std::mutex> lock(objectsMutex);
+            if (!watcher) return;
+            changed.clear();
+            if (watcher->poll(changed)) {
+                for (auto& o : objects) {
+                    if (!o.second) continue;
+                    std::vector<std::string> filenames = o.second->getFilenames();
+                    bool uses = false;
+                    for (const std::string& filename : changed) {
+                        uses = uses ||
+                            std::find(filenames.begin(), filenames.end(), filename) != filenames.end();
+                    }
+                    if (uses) reloads.push_back(o);
+                }
+            }
+        }
+        for (auto& o : reloads) {
+            std::cout << "Reloading shader [" << o.first << "]" << std::endl;
+            o.second->reload();
+            if (std::find(reloading.begin(), reloading.end(), o.second) == reloading.end()) {
+                reloading.push_back(o.second);
+            }
+        }
+        for (size_t i = 0; i < reloading.size();) {
+            if (!reloading[i]->pollReload()) {
+                i++;
+                continue;
+            }
+            reloading[i] = reloading.back();
+            reloading.pop_back();
+            Engine::getInstance().requestRedraw();
+        }
+    }
+
+    // Context thread only. How long that thread may sleep before update()
+    // has work again; 0 when only an event can bring it some.
+    double ShaderManager::getIdleTimeout() {
+        if (!reloading.empty()) return RELOAD_CHECK_SECONDS;
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        return watcher ? FileWatcher::CHECK_SECONDS : 0.0;
+    }
+
+    /////////////////////////////////////////////////////////////////// MESH MANAGER
+
+    MeshManager& MeshManager::getInstance() {
+        static MeshManager instance;
+        return instance;
+    }
+
+    MeshManager::MeshManager() {}
+
+    // Queued imports are dropped; workers finish the one they are on.
+    MeshManager::~MeshManager() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    std::future<Mesh*> MeshManager::load(const std::string& key,
+        const std::string& filename, Mesh* mesh, LoadCallback callback) {
+        LoadRequest request;
+        request.key = key;
+        request.filename = filename;
+        request.mesh = mesh;
+        request.callback = callback;
+        return std::move(load(std::vector<LoadRequest>(1, request)).front());
+    }
+
+    // One worker per core but one, started with the first batch.
+    std::vector<std::future<Mesh*>> MeshManager::load(
+        const std::vector<LoadRequest>& requests) {
+        std::vector<std::future<Mesh*>> futures;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const LoadRequest& request : requests) {
+                std::unique_ptr<Job> job(new Job);
+                job->request = request;
+                futures.push_back(job->promise.get_future());
+                jobs.push_back(std::move(job));
+                pending++;
+            }
+            if (workers.empty()) {
+                unsigned int cores = std::thread::hardware_concurrency();
+                unsigned int count = cores > 1 ? cores - 1 : 1;
+                for (unsigned int i = 0; i < count; i++) {
+                    workers.emplace_back(&MeshManager::work, this);
+                }
+            }
+        }
+        jobReady.notify_all();
+        return futures;
+    }
+
+    void MeshManager::work() {
+        for (;;) {
+            std::unique_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job->loaded = job->request.mesh->load(job->request.filename);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                uploads.push_back(std::move(job));
+            }
+            uploadReady.notify_one();
+            Engine::getInstance().wake();
+        }
+    }
+
+    // Context thread only. Finishes at most budget loaded meshes.
+    size_t MeshManager::upload(size_t budget) {
+        size_t count = 0;
+        while (count < budget) {
+            std::unique_ptr<Job> job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (uploads.empty()) break;
+                job = std::move(uploads.front());
+                uploads.pop_front();
+            }
+            finish(*job);
+            count++;
+        }
+        return count;
+    }
+
+    void MeshManager::finish(Job& job) {
+        LoadRequest& request = job.request;
+        std::string error;
+        if (job.loaded) {
+            request.mesh->upload();
+            add(request.key, request.mesh);
+#ifdef DEBUG
+            if (request.mesh->isShared()) {
+                std::cout << "Mesh [" << request.key << "] shares its geometry"
+                    << std::endl;
+            }
+#endif
+        }
+        else {
+            error = request.mesh->getError();
+            std::cerr << "Error while loading [" << request.filename << "]: " << error
+                << std::endl;
+            delete request.mesh;
+            request.mesh = nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending--;
+        }
+        Engine::getInstance().requestRedraw();
+        job.promise.set_value(request.mesh);
+        if (request.callback) {
+            request.callback(request.key, request.mesh, error);
+        }
+    }
+
+    // Context thread only. Uploads as workers finish until none is pending.
+    void MeshManager::wait() {
+        for (;;) {
+            upload();
+            std::unique_lock<std::mutex> lock(mutex);
+            if (pending == 0) return;
+            uploadReady.wait(lock, [this] { return !uploads.empty(); });
+        }
+    }
+
+    size_t MeshManager::getPendingCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -8,15 +8,74 @@
 
 #include "./mglMesh.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glm/gtx/transform.hpp>
+
+#include "./mglMeshOptimizer.hpp"
+#include "./mglRingBuffer.hpp"
+#include "./mglShaderVariants.hpp"
+#include "./mglProfiler.hpp"
+
 namespace mgl {
 
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    // Cooked Mesh [header, MeshData ranges, meshlets, packed vertices,
+    // indices]
+    const glm::uint32 COOKED_VERSION = 3;
+#ifdef CREATE_BITANGENT
+    const glm::uint32 COOKED_BITANGENTS = 1;
+#else
+    const glm::uint32 COOKED_BITANGENTS = 0;
+#endif
+
+    enum CookedAttribute {
+        COOKED_NORMALS = 1,
+        COOKED_TEXCOORDS = 2,
+        COOKED_TANGENTS = 4,
+        COOKED_COMPRESSED = 8
+    };
+
+    struct CookedHeader {
+        char magic[4];
+        glm::uint32 version;
+        glm::uint64 key;
+        glm::uint64 content;
+        glm::uint32 attributes;
+        glm::uint32 stride;
+        glm::uint32 meshCount;
+        glm::uint32 vertexCount;
+        glm::uint32 indexCount;
+        glm::uint32 meshletCount;
+        float radius;
+        glm::vec3 center;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsExtent;
+    };
+
     ////////////////////////////////////////////////////////////////////////////////
 
     Mesh::Mesh() {
         NormalsLoaded = false;
         TexcoordsLoaded = false;
         TangentsAndBitangentsLoaded = false;
-        VaoId = -1;
+        VerticesCompressed = false;
+        Optimized = false;
+        Clustered = false;
+        Retention = VertexRetention::DROP;
+        Geometry = nullptr;
+        VertexStride = 0;
+        VertexCount = 0;
+        CookedKey = 0;
+        ContentKey = 0;
+        StagedVertexData = nullptr;
+        StagedIndexData = nullptr, StagedIndexCount = 0;
+        Center = glm::vec3(0.0f);
+        Radius = 0.0f;
+        BoundsMin = glm::vec3(0.0f), BoundsExtent = glm::vec3(1.0f);
         AssimpFlags = aiProcess_Triangulate;
     }
 
@@ -42,46 +101,231 @@ namespace mgl {
 
     void Mesh::flipUVs() { AssimpFlags |= aiProcess_FlipUVs; }
 
+    // Quantizes every attribute on upload [about 3x smaller]; the error is
+    // reported per mesh. Shaders must decode octahedral normals and draw
+    // with getPositionMatrix() folded into the model matrix.
+    void Mesh::compressVertices() { VerticesCompressed = true; }
+
+    // Reorders triangles for the post-transform cache and to draw occluders
+    // first, then vertices in fetch order. The cache miss ratios before and
+    // after are reported per mesh.
+    void Mesh::optimize() { Optimized = true; }
+
+    // Splits the index buffer into meshlets culled on their own at draw
+    // time; best after optimize(), whose order keeps meshlets compact.
+    void Mesh::splitMeshlets() { Clustered = true; }
+
+    // Meshes are cooked into directory after import and loaded from there,
+    // without Assimp, while the source file and flags stay the same.
+    void Mesh::setCacheDirectory(const std::string& directory) {
+        CacheDirectory = directory;
+    }
+
+    void Mesh::setRetention(VertexRetention retention) { Retention = retention; }
+
     bool Mesh::hasNormals() { return NormalsLoaded; }
 
     bool Mesh::hasTexcoords() { return TexcoordsLoaded; }
 
     bool Mesh::hasTangentsAndBitangents() { return TangentsAndBitangentsLoaded; }
 
-    ////////////////////////////////////////////////////////////////////////////////
+    glm::vec3 Mesh::getCenter() { return Center; }
 
-    void Mesh::processMesh(const aiMesh* mesh) {
-        NormalsLoaded = mesh->HasNormals();
-        TexcoordsLoaded = mesh->HasTextureCoords(0);
-        TangentsAndBitangentsLoaded = mesh->HasTangentsAndBitangents();
+    float Mesh::getRadius() { return Radius; }
 
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-            const aiVector3D& aiPosition = mesh->mVertices[i];
-            Positions.push_back(glm::vec3(aiPosition.x, aiPosition.y, aiPosition.z));
-            if (NormalsLoaded) {
-                const aiVector3D& aiNormal = mesh->mNormals[i];
-                Normals.push_back(glm::vec3(aiNormal.x, aiNormal.y, aiNormal.z));
+    GLsizei Mesh::getVertexStride() { return VertexStride; }
+
+    bool Mesh::hasCompressedVertices() { return VerticesCompressed; }
+
+    // Of the shader variant that draws it [see ShaderFeature].
+    unsigned int Mesh::getShaderFeatures() {
+        unsigned int features = 0;
+        if (NormalsLoaded) features |= NORMALS;
+        if (TexcoordsLoaded) features |= TEXCOORDS;
+        if (TangentsAndBitangentsLoaded) features |= TANGENTS;
+        if (VerticesCompressed) features |= COMPRESSED;
+        return features;
+    }
+
+    bool Mesh::hasMeshlets() { return !Meshlets.empty(); }
+
+    size_t Mesh::getMeshletCount() { return Meshlets.size(); }
+
+    // True while another mesh with identical geometry uses the same buffers.
+    bool Mesh::isShared() { return Geometry && Geometry->references > 1; }
+
+    // Maps quantized positions in [0, 1]^3 back onto the bounding box.
+    glm::mat4 Mesh::getPositionMatrix() {
+        if (!VerticesCompressed) return glm::mat4(1.0f);
+        return glm::translate(BoundsMin) * glm::scale(BoundsExtent);
+    }
+
+    // Empty unless the retention policy keeps them.
+    const std::vector<glm::vec3>& Mesh::getPositions() { return Positions; }
+
+    const std::vector<unsigned int>& Mesh::getIndices() { return Indices; }
+
+    // Levels are kept sorted by decreasing screen size.
+    void Mesh::addLod(Mesh* lod, float screenSize) {
+        MeshLod level = { lod, screenSize };
+        auto at = std::find_if(Lods.begin(), Lods.end(),
+            [screenSize](const MeshLod& l) { return l.screenSize < screenSize; });
+        Lods.insert(at, level);
+    }
+
+    const std::vector<MeshLod>& Mesh::getLods() { return Lods; }
+
+    const GeometryAllocation* Mesh::getGeometry() { return Geometry; }
+
+    // Positions and normals of every submesh moved by world, with indices
+    // rebased onto the vertices appended. False when the arrays were not
+    // kept; normals are zero for meshes without them.
+    bool Mesh::appendTransformed(const glm::mat4& world, std::vector<glm::vec3>& positions,
+        std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices) {
+        if (Positions.empty() || Indices.empty()) return false;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+        unsigned int first = (unsigned int)positions.size();
+        for (size_t i = 0; i < Positions.size(); i++) {
+            positions.push_back(glm::vec3(world * glm::vec4(Positions[i], 1.0f)));
+            normals.push_back(Normals.empty()
+                ? glm::vec3(0.0f) : glm::normalize(normalMatrix * Normals[i]));
+        }
+        for (const MeshData& mesh : Meshes) {
+            for (unsigned int i = 0; i < mesh.nIndices; i++) {
+                indices.push_back(first + mesh.baseVertex + Indices[mesh.baseIndex + i]);
             }
-            if (TexcoordsLoaded) {
-                const aiVector3D& aiTexcoord = mesh->mTextureCoords[0][i];
-                Texcoords.push_back(glm::vec2(aiTexcoord.x, aiTexcoord.y));
+        }
+        return true;
+    }
+
+    // What draw() or drawMeshlets() would draw, as ranges of the pool
+    // buffers: a meshlet each, or a submesh each bounded by the mesh sphere
+    // and never culled by its cone.
+    void Mesh::appendDrawRanges(std::vector<Meshlet>& out) {
+        if (!Meshlets.empty()) {
+            for (const Meshlet& meshlet : Meshlets) {
+                out.push_back(meshlet);
+                out.back().firstIndex += (unsigned int)Geometry->firstIndex;
+                out.back().baseVertex = (unsigned int)(Geometry->firstVertex +
+                    meshlet.baseVertex * Geometry->vertexUnits);
             }
-            if (TangentsAndBitangentsLoaded) {
-                const aiVector3D& aiTangent = mesh->mTangents[i];
-                Tangents.push_back(glm::vec3(aiTangent.x, aiTangent.y, aiTangent.z));
+            return;
+        }
+        for (const MeshData& mesh : Meshes) {
+            Meshlet range = Meshlet();
+            range.center = Center;
+            range.radius = Radius;
+            range.firstIndex = (unsigned int)(Geometry->firstIndex + mesh.baseIndex);
+            range.indexCount = mesh.nIndices;
+            range.baseVertex = (unsigned int)(Geometry->firstVertex +
+                mesh.baseVertex * Geometry->vertexUnits);
+            out.push_back(range);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
 
+    // aiVector3D is three floats like glm::vec3, so whole arrays are copied
+    // at once into the ranges processScene sized.
+    void Mesh::processMesh(const aiMesh* mesh, const MeshData& data) {
+        static_assert(sizeof(aiVector3D) == sizeof(glm::vec3),
+            "aiVector3D and glm::vec3 must have the same layout");
+        if (mesh->mNumVertices == 0) return;
+        size_t bytes = sizeof(glm::vec3) * mesh->mNumVertices;
+
+        std::memcpy(&Positions[data.baseVertex], mesh->mVertices, bytes);
+        if (NormalsLoaded) {
+            std::memcpy(&Normals[data.baseVertex], mesh->mNormals, bytes);
+        }
+        if (TexcoordsLoaded) {
+            const aiVector3D* aiTexcoords = mesh->mTextureCoords[0];
+            glm::vec2* texcoords = &Texcoords[data.baseVertex];
+            for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+                texcoords[i] = glm::vec2(aiTexcoords[i].x, aiTexcoords[i].y);
+            }
+        }
+        if (TangentsAndBitangentsLoaded) {
+            std::memcpy(&Tangents[data.baseVertex], mesh->mTangents, bytes);
 #ifdef CREATE_BITANGENT
-                const aiVector3D& aiBitangent = mesh->mBitangents[i];
-                Bitangents.push_back(
-                    glm::vec3(aiBitangent.x, aiBitangent.y, aiBitangent.z));
+            std::memcpy(&Bitangents[data.baseVertex], mesh->mBitangents, bytes);
 #endif
-            }
         }
+
+        unsigned int* indices = &Indices[data.baseIndex];
         for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            const aiFace& face = mesh->mFaces[i];
-            Indices.push_back(face.mIndices[0]);
-            Indices.push_back(face.mIndices[1]);
-            Indices.push_back(face.mIndices[2]);
+            const unsigned int* face = mesh->mFaces[i].mIndices;
+            indices[3 * i] = face[0];
+            indices[3 * i + 1] = face[1];
+            indices[3 * i + 2] = face[2];
+        }
+    }
+
+    // Each submesh is optimized on its own, indices stay local to baseVertex.
+    void Mesh::optimizeMeshes() {
+        MGL_PROFILE_SCOPE("Mesh::optimizeMeshes")
+        VertexCacheStats before, after;
+        for (MeshData& m : Meshes) {
+            if (m.nIndices == 0) continue;
+            unsigned int* indices = &Indices[m.baseIndex];
+            VertexCacheStats stats = analyzeVertexCache(indices, m.nIndices, m.nVertices);
+            before.acmr += stats.acmr * m.nIndices / Indices.size();
+            before.atvr += stats.atvr * m.nVertices / Positions.size();
+
+            std::vector<size_t> clusters;
+            optimizeVertexCache(indices, m.nIndices, m.nVertices, 16, &clusters);
+            optimizeOverdraw(indices, m.nIndices, &Positions[m.baseVertex], clusters);
+
+            std::vector<unsigned int> remap =
+                optimizeVertexFetch(indices, m.nIndices, m.nVertices);
+            remapVertices(&Positions[m.baseVertex], remap);
+            if (NormalsLoaded) remapVertices(&Normals[m.baseVertex], remap);
+            if (TexcoordsLoaded) remapVertices(&Texcoords[m.baseVertex], remap);
+            if (TangentsAndBitangentsLoaded) {
+                remapVertices(&Tangents[m.baseVertex], remap);
+#ifdef CREATE_BITANGENT
+                remapVertices(&Bitangents[m.baseVertex], remap);
+#endif
+            }
+
+            stats = analyzeVertexCache(indices, m.nIndices, m.nVertices);
+            after.acmr += stats.acmr * m.nIndices / Indices.size();
+            after.atvr += stats.atvr * m.nVertices / Positions.size();
+        }
+        std::cout << "Optimized mesh [ACMR " << before.acmr << " -> " << after.acmr
+            << ", ATVR " << before.atvr << " -> " << after.atvr << "]" << std::endl;
+    }
+
+    void Mesh::createMeshlets() {
+        MGL_PROFILE_SCOPE("Mesh::createMeshlets")
+        for (MeshData& m : Meshes) {
+            if (m.nIndices == 0) continue;
+            size_t first = Meshlets.size();
+            buildMeshlets(&Indices[m.baseIndex], m.nIndices, &Positions[m.baseVertex],
+                m.nVertices, Meshlets);
+            for (size_t i = first; i < Meshlets.size(); i++) {
+                Meshlets[i].firstIndex += m.baseIndex;
+                Meshlets[i].baseVertex = m.baseVertex;
+            }
+        }
+#ifdef DEBUG
+        std::cout << "Split into " << Meshlets.size() << " meshlet(s)" << std::endl;
+#endif
+    }
+
+    // Sphere around the axis-aligned box of all positions; loose but cheap.
+    void Mesh::computeBounds() {
+        if (Positions.empty()) return;
+        glm::vec3 min = Positions[0], max = Positions[0];
+        for (const glm::vec3& p : Positions) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        Center = 0.5f * (min + max);
+        Radius = 0.5f * glm::length(max - min);
+        BoundsMin = min;
+        BoundsExtent = max - min;
+        for (int i = 0; i < 3; i++) {
+            if (BoundsExtent[i] <= 0.0f) BoundsExtent[i] = 1.0f;
         }
     }
 
@@ -93,18 +337,41 @@ namespace mgl {
             Meshes[i].nIndices = scene->mMeshes[i]->mNumFaces * 3;
             Meshes[i].baseVertex = n_vertices;
             Meshes[i].baseIndex = n_indices;
+            Meshes[i].nVertices = scene->mMeshes[i]->mNumVertices;
 
             n_vertices += scene->mMeshes[i]->mNumVertices;
             n_indices += Meshes[i].nIndices;
         }
-        Positions.reserve(n_vertices);
-        Normals.reserve(n_vertices);
-        Texcoords.reserve(n_vertices);
-        Indices.reserve(n_indices);
 
+        // an attribute is only used if every submesh has it, so the arrays
+        // stay aligned with Positions
+        NormalsLoaded = TexcoordsLoaded = TangentsAndBitangentsLoaded = true;
         for (unsigned int i = 0; i < Meshes.size(); i++) {
-            processMesh(scene->mMeshes[i]);
+            NormalsLoaded &= scene->mMeshes[i]->HasNormals();
+            TexcoordsLoaded &= scene->mMeshes[i]->HasTextureCoords(0);
+            TangentsAndBitangentsLoaded &= scene->mMeshes[i]->HasTangentsAndBitangents();
         }
+        Positions.resize(n_vertices);
+        if (NormalsLoaded) Normals.resize(n_vertices);
+        if (TexcoordsLoaded) Texcoords.resize(n_vertices);
+        if (TangentsAndBitangentsLoaded) {
+            Tangents.resize(n_vertices);
+#ifdef CREATE_BITANGENT
+            Bitangents.resize(n_vertices);
+#endif
+        }
+        Indices.resize(n_indices);
+
+        for (unsigned int i = 0; i < Meshes.size(); i++) {
+            processMesh(scene->mMeshes[i], Meshes[i]);
+        }
+        if (Optimized) {
+            optimizeMeshes();
+        }
+        if (Clustered) {
+            createMeshlets();
+        }
+        computeBounds();
 
 #ifdef DEBUG
         std::cout << "Loaded " << Meshes.size() << " mesh(es) [" << n_vertices
@@ -114,13 +381,34 @@ namespace mgl {
     }
 
     void Mesh::create(const std::string& filename) {
+        if (!load(filename)) {
+            std::cout << "Error while loading:" << Error << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        upload();
+    }
+
+    // CPU half of create, safe on any thread: import and processing, or a
+    // mapped cooked file. Buffers are only made by upload().
+    bool Mesh::load(const std::string& filename) {
+        MGL_PROFILE_SCOPE("Mesh::load")
+        // the cooked cache only holds packed data, so meshes that keep their
+        // arrays are imported again and only refresh it
+        std::string cooked;
+        if (!CacheDirectory.empty()) {
+            cooked = getCookedPath(filename);
+            if (!cooked.empty() && Retention == VertexRetention::DROP &&
+                loadCooked(cooked)) {
+                return true;
+            }
+        }
+
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(filename, AssimpFlags);
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
             !scene->mRootNode) {
-            std::cout << "Error while loading:" << importer.GetErrorString()
-                << std::endl;
-            exit(EXIT_FAILURE);
+            Error = importer.GetErrorString();
+            return false;
         }
 
 #ifdef DEBUG
@@ -128,86 +416,303 @@ namespace mgl {
 #endif
 
         processScene(scene);
-        createBufferObjects();
+        packVertexData(StagedVertices);
+        VertexCount = Positions.size();
+        StagedVertexData = StagedVertices.data();
+        StagedIndexData = Indices.data();
+        StagedIndexCount = Indices.size();
+        ContentKey = hashBytes(Indices.data(), sizeof(unsigned int) * Indices.size(),
+            hashBytes(StagedVertices.data(), StagedVertices.size()));
+        if (!cooked.empty()) {
+            saveCooked(cooked, StagedVertices);
+        }
+        return true;
     }
 
-    void Mesh::createBufferObjects() {
-        GLuint boId[6];
+    // GL half of create, on the context thread after load() succeeded.
+    void Mesh::upload() {
+        MGL_PROFILE_SCOPE("Mesh::upload")
+        createBufferObjects(StagedVertexData, StagedIndexData, StagedIndexCount);
+        StagedVertexData = nullptr;
+        StagedIndexData = nullptr;
+        std::vector<unsigned char>().swap(StagedVertices);
+        CookedFile.close();
+        releaseVertices();
+    }
 
-        glGenVertexArrays(1, &VaoId);
-        glBindVertexArray(VaoId);
-        {
-            glGenBuffers(6, boId);
+    void Mesh::releaseVertices() {
+        if (Retention == VertexRetention::KEEP) return;
+        std::vector<glm::vec3>().swap(Normals);
+        std::vector<glm::vec2>().swap(Texcoords);
+        std::vector<glm::vec3>().swap(Tangents);
+#ifdef CREATE_BITANGENT
+        std::vector<glm::vec3>().swap(Bitangents);
+#endif
+        if (Retention == VertexRetention::DROP) {
+            std::vector<glm::vec3>().swap(Positions);
+            std::vector<unsigned int>().swap(Indices);
+        }
+    }
 
-            glBindBuffer(GL_ARRAY_BUFFER, boId[POSITION]);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(),
-                &Positions[0], GL_STATIC_DRAW);
-            glEnableVertexAttribArray(POSITION);
-            glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    const std::string& Mesh::getError() { return Error; }
 
-            if (NormalsLoaded) {
-                glBindBuffer(GL_ARRAY_BUFFER, boId[NORMAL]);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(),
-                    &Normals[0], GL_STATIC_DRAW);
-                glEnableVertexAttribArray(NORMAL);
-                glVertexAttribPointer(NORMAL, 3, GL_FLOAT, GL_FALSE, 0, 0);
-            }
+    ////////////////////////////////////////////////////////////////////////// COOKED
 
-            if (TexcoordsLoaded) {
-                glBindBuffer(GL_ARRAY_BUFFER, boId[TEXCOORD]);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(Texcoords[0]) * Texcoords.size(),
-                    &Texcoords[0], GL_STATIC_DRAW);
-                glEnableVertexAttribArray(TEXCOORD);
-                glVertexAttribPointer(TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, 0);
-            }
+    // Keyed by the source bytes and every option that changes the arrays;
+    // empty if the source cannot be read, which Assimp then reports.
+    std::string Mesh::getCookedPath(const std::string& filename) {
+        MappedFile source;
+        if (!source.open(filename)) return "";
+        glm::uint32 options[] = { COOKED_VERSION, AssimpFlags, Optimized, Clustered,
+            VerticesCompressed, COOKED_BITANGENTS };
+        CookedKey = hashBytes(options, sizeof(options),
+            hashBytes(source.data(), source.size()));
 
-            if (TangentsAndBitangentsLoaded) {
-                glBindBuffer(GL_ARRAY_BUFFER, boId[TANGENT]);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(Tangents[0]) * Tangents.size(),
-                    &Tangents[0], GL_STATIC_DRAW);
-                glEnableVertexAttribArray(TANGENT);
-                glVertexAttribPointer(TANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.mesh",
+            (unsigned long long)CookedKey);
+        return CacheDirectory + "/" + name;
+    }
 
-#ifdef CREATE_BITANGENT
-                glBindBuffer(GL_ARRAY_BUFFER, boId[BITANGENT]);
-                glBufferData(GL_ARRAY_BUFFER, sizeof(Bitangents[0]) * Bitangents.size(),
-                    &Bitangents[0], GL_STATIC_DRAW);
-                glEnableVertexAttribArray(BITANGENT);
-                glVertexAttribPointer(BITANGENT, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    // The file stays mapped until upload() copies it into the buffers.
+    bool Mesh::loadCooked(const std::string& path) {
+        MGL_PROFILE_SCOPE("Mesh::loadCooked")
+        MappedFile& file = CookedFile;
+        if (!file.open(path) || file.size() < sizeof(CookedHeader)) return false;
+        CookedHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        size_t meshBytes = sizeof(MeshData) * header.meshCount;
+        size_t meshletBytes = sizeof(Meshlet) * header.meshletCount;
+        size_t vertexBytes = (size_t)header.stride * header.vertexCount;
+        size_t indexBytes = sizeof(unsigned int) * header.indexCount;
+        if (std::memcmp(header.magic, "MGLM", 4) || header.version != COOKED_VERSION ||
+            header.key != CookedKey || file.size() != sizeof(header) + meshBytes +
+            meshletBytes + vertexBytes + indexBytes) {
+            file.close();
+            return false;
+        }
+
+        NormalsLoaded = (header.attributes & COOKED_NORMALS) != 0;
+        TexcoordsLoaded = (header.attributes & COOKED_TEXCOORDS) != 0;
+        TangentsAndBitangentsLoaded = (header.attributes & COOKED_TANGENTS) != 0;
+        VerticesCompressed = (header.attributes & COOKED_COMPRESSED) != 0;
+        VertexStride = header.stride;
+        VertexCount = header.vertexCount;
+        Center = header.center;
+        Radius = header.radius;
+        BoundsMin = header.boundsMin;
+        BoundsExtent = header.boundsExtent;
+        ContentKey = header.content;
+
+        const unsigned char* data = file.data() + sizeof(header);
+        Meshes.resize(header.meshCount);
+        std::memcpy(Meshes.data(), data, meshBytes);
+        data += meshBytes;
+        Meshlets.resize(header.meshletCount);
+        std::memcpy(Meshlets.data(), data, meshletBytes);
+        data += meshletBytes;
+        StagedVertexData = data;
+        StagedIndexData = reinterpret_cast<const unsigned int*>(data + vertexBytes);
+        StagedIndexCount = header.indexCount;
+
+#ifdef DEBUG
+        std::cout << "Loaded cooked [" << path << "] " << Meshes.size()
+            << " mesh(es) [" << header.vertexCount << " vertices, "
+            << header.indexCount << " indices]" << std::endl;
 #endif
+        return true;
+    }
+
+    // Written aside and renamed, so a crash never leaves a torn file behind.
+    void Mesh::saveCooked(const std::string& path,
+        const std::vector<unsigned char>& vertices) {
+        if (!createDirectory(CacheDirectory)) {
+            std::cerr << "Cannot create mesh cache [" << CacheDirectory << "]"
+                << std::endl;
+            return;
+        }
+        CookedHeader header;
+        std::memcpy(header.magic, "MGLM", 4);
+        header.version = COOKED_VERSION;
+        header.key = CookedKey;
+        header.content = ContentKey;
+        header.attributes = (NormalsLoaded ? COOKED_NORMALS : 0) |
+            (TexcoordsLoaded ? COOKED_TEXCOORDS : 0) |
+            (TangentsAndBitangentsLoaded ? COOKED_TANGENTS : 0) |
+            (VerticesCompressed ? COOKED_COMPRESSED : 0);
+        header.stride = VertexStride;
+        header.meshCount = (glm::uint32)Meshes.size();
+        header.vertexCount = (glm::uint32)VertexCount;
+        header.indexCount = (glm::uint32)Indices.size();
+        header.meshletCount = (glm::uint32)Meshlets.size();
+        header.radius = Radius;
+        header.center = Center;
+        header.boundsMin = BoundsMin;
+        header.boundsExtent = BoundsExtent;
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(Meshes.data()),
+                sizeof(MeshData) * Meshes.size());
+            file.write(reinterpret_cast<const char*>(Meshlets.data()),
+                sizeof(Meshlet) * Meshlets.size());
+            file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size());
+            file.write(reinterpret_cast<const char*>(Indices.data()),
+                sizeof(unsigned int) * Indices.size());
+            if (!file) {
+                std::cerr << "Cannot write cooked mesh [" << path << "]" << std::endl;
+                return;
             }
+        }
+        std::remove(path.c_str());
+        std::rename(temporary.c_str(), path.c_str());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
 
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boId[INDEX]);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(),
-                &Indices[0], GL_STATIC_DRAW);
+    // Calls f with the vertex format for the attributes loaded; tangent
+    // space is only generated with normals and texcoords.
+    template<class Function>
+    void Mesh::withVertexFormat(bool compressed, Function f) {
+        if (compressed) {
+            if (TangentsAndBitangentsLoaded) f(PNTTBPackedFormat());
+            else if (NormalsLoaded && TexcoordsLoaded) f(PNTPackedFormat());
+            else if (NormalsLoaded) f(PNPackedFormat());
+            else if (TexcoordsLoaded) f(PTPackedFormat());
+            else f(PPackedFormat());
         }
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDeleteBuffers(6, boId);
+        else if (TangentsAndBitangentsLoaded) f(PNTTBFormat());
+        else if (NormalsLoaded && TexcoordsLoaded) f(PNTFormat());
+        else if (NormalsLoaded) f(PNFormat());
+        else if (TexcoordsLoaded) f(PTFormat());
+        else f(PFormat());
     }
 
-    void Mesh::destroyBufferObjects() {
-        glBindVertexArray(VaoId);
-        glDisableVertexAttribArray(POSITION);
-        glDisableVertexAttribArray(NORMAL);
-        glDisableVertexAttribArray(TEXCOORD);
-        glDisableVertexAttribArray(TANGENT);
+    void Mesh::packVertexData(std::vector<unsigned char>& vertices) {
+        VertexSource source;
+        source.positions = Positions.data();
+        source.normals = Normals.data();
+        source.texcoords = Texcoords.data();
+        source.tangents = Tangents.data();
 #ifdef CREATE_BITANGENT
-        glDisableVertexAttribArray(BITANGENT);
+        source.bitangents = Bitangents.data();
 #endif
-        glDeleteVertexArrays(1, &VaoId);
-        glBindVertexArray(0);
+        source.boundsMin = BoundsMin;
+        source.boundsExtent = BoundsExtent;
+
+        withVertexFormat(VerticesCompressed, [&](auto format) {
+            typedef decltype(format) Format;
+            packVertices<Format>(source, Positions.size(), vertices);
+            VertexStride = Format::stride();
+        });
+        if (VerticesCompressed) {
+            reportCompression(source);
+        }
+    }
+
+    // All attributes go interleaved, so a vertex fetch touches one place in
+    // memory instead of one per attribute, into the geometry pool arena of
+    // the vertex format; the data may come straight from a mapped cooked
+    // file. Geometry already in the pool with the same content is shared.
+    void Mesh::createBufferObjects(const void* vertices, const unsigned int* indices,
+        size_t indexCount) {
+        VertexLayout layout;
+        withVertexFormat(VerticesCompressed, [&](auto format) {
+            layout = decltype(format)::layout();
+        });
+        GeometryPool& pool = GeometryPool::getInstance();
+        Geometry = pool.acquire(layout, ContentKey, VertexCount, indexCount);
+        if (Geometry) return;
+        Geometry = pool.allocate(layout, VertexCount, indexCount, ContentKey);
+        pool.upload(Geometry, vertices, indices);
+    }
+
+    // Decodes every packed attribute the way the GPU does and compares it
+    // with the float original.
+    void Mesh::reportCompression(const VertexSource& source) {
+        GLsizei stride = 0;
+        withVertexFormat(false, [&](auto format) {
+            stride = decltype(format)::stride();
+        });
+        double position = 0.0, normal = 0.0, tangent = 0.0, texcoord = 0.0;
+        for (size_t i = 0; i < Positions.size(); i++) {
+            unsigned char packed[8];
+            PackedPositionAttribute::pack(source, i, packed);
+            glm::uint64 p;
+            std::memcpy(&p, packed, sizeof(p));
+            glm::vec3 q = BoundsMin + glm::vec3(glm::unpackUnorm4x16(p)) * BoundsExtent;
+            position = glm::max(position, (double)glm::length(q - Positions[i]));
+
+            glm::uint32 v;
+            if (NormalsLoaded) {
+                PackedNormalAttribute::pack(source, i, packed);
+                std::memcpy(&v, packed, sizeof(v));
+                glm::vec3 n = decodeOctahedral(glm::vec2(glm::unpackSnorm3x10_1x2(v)));
+                float c = glm::clamp(glm::dot(n, glm::normalize(Normals[i])), -1.0f, 1.0f);
+                normal = glm::max(normal, (double)glm::degrees(glm::acos(c)));
+            }
+            if (TangentsAndBitangentsLoaded) {
+                PackedTangentAttribute::pack(source, i, packed);
+                std::memcpy(&v, packed, sizeof(v));
+                glm::vec3 t = decodeOctahedral(glm::vec2(glm::unpackSnorm3x10_1x2(v)));
+                float c = glm::clamp(glm::dot(t, glm::normalize(Tangents[i])), -1.0f, 1.0f);
+                tangent = glm::max(tangent, (double)glm::degrees(glm::acos(c)));
+            }
+            if (TexcoordsLoaded) {
+                PackedTexcoordAttribute::pack(source, i, packed);
+                std::memcpy(&v, packed, sizeof(v));
+                glm::vec2 d = glm::abs(glm::unpackHalf2x16(v) - Texcoords[i]);
+                texcoord = glm::max(texcoord, (double)glm::max(d.x, d.y));
+            }
+        }
+        std::cout << "Compressed vertices [" << stride << " -> " << VertexStride
+            << " bytes, " << (float)stride / VertexStride << "x] max error [position "
+            << position << " (" << 100.0 * position / glm::length(BoundsExtent)
+            << "% of box), normal " << normal << " deg, tangent " << tangent
+            << " deg, texcoord " << texcoord << "]" << std::endl;
+    }
+
+    void Mesh::destroyBufferObjects() {
+        if (!Geometry) return;
+        GeometryPool::getInstance().free(Geometry);
+        Geometry = nullptr;
+    }
+
+    // Culls the meshlets on the CPU and draws the survivors with one
+    // indirect call; commands live in the ring buffer for the frame.
+    void Mesh::drawMeshlets(const glm::mat4& modelViewProjection, const glm::vec3& eye) {
+        MGL_PROFILE_SCOPE("Mesh::drawMeshlets")
+        RingBuffer& ring = RingBuffer::getInstance();
+        if (!ring.getRegionSize()) ring.create(1 << 20);
+        size_t batch = ring.getRegionSize() / sizeof(DrawCommand);
+        GeometryPool::getInstance().bind(Geometry);
+        for (size_t first = 0; first < Meshlets.size(); first += batch) {
+            size_t count = std::min(batch, Meshlets.size() - first);
+            RingBuffer::Allocation commands = ring.allocate(sizeof(DrawCommand) * count);
+            count = cullMeshlets(&Meshlets[first], count, modelViewProjection, eye,
+                (GLuint)Geometry->firstIndex, (GLint)Geometry->firstVertex,
+                static_cast<DrawCommand*>(commands.data));
+            if (count == 0) continue;
+            commands.size = sizeof(DrawCommand) * count;
+            ring.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                reinterpret_cast<void*>(commands.offset), (GLsizei)count, 0);
+        }
     }
 
+    // The arena VAO stays bound for the next mesh of the same format.
     void Mesh::draw() {
-        glBindVertexArray(VaoId);
+        MGL_PROFILE_SCOPE("Mesh::draw")
+        GeometryPool::getInstance().bind(Geometry);
         for (MeshData& mesh : Meshes) {
             glDrawElementsBaseVertex(
                 GL_TRIANGLES, mesh.nIndices, GL_UNSIGNED_INT,
-                reinterpret_cast<void*>((sizeof(unsigned int) * mesh.baseIndex)),
-                mesh.baseVertex);
+                reinterpret_cast<void*>(
+                    (sizeof(unsigned int) * (Geometry->firstIndex + mesh.baseIndex))),
+                (GLint)(Geometry->firstVertex + mesh.baseVertex * Geometry->vertexUnits));
         }
-        glBindVertexArray(0);
     }
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,192 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Mesh Optimization Functions
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMeshOptimizer.hpp"
+
+#include <algorithm>
+
+namespace mgl {
+
+    /////////////////////////////////////////////////////////////////// VERTEX CACHE
+
+    VertexCacheStats analyzeVertexCache(const unsigned int* indices,
+        std::size_t indexCount, std::size_t vertexCount, std::size_t cacheSize) {
+        // a vertex is cached if fewer than cacheSize misses happened since
+        // its own miss
+        std::vector<std::size_t> missedAt(vertexCount, 0);
+        std::vector<bool> referenced(vertexCount, false);
+        std::size_t misses = 0, unique = 0;
+        for (std::size_t i = 0; i < indexCount; i++) {
+            unsigned int v = indices[i];
+            if (!referenced[v]) {
+                referenced[v] = true;
+                unique++;
+            }
+            if (missedAt[v] == 0 || misses - missedAt[v] >= cacheSize) {
+                misses++;
+                missedAt[v] = misses;
+            }
+        }
+        VertexCacheStats stats;
+        if (indexCount > 0) stats.acmr = (double)misses / (indexCount / 3);
+        if (unique > 0) stats.atvr = (double)misses / unique;
+        return stats;
+    }
+
+    // Candidates are the vertices of the fan just emitted: prefer one that
+    // is still in cache and whose remaining triangles fit in it, else fall
+    // back to recently used vertices, else to any vertex with triangles left.
+    void optimizeVertexCache(unsigned int* indices, std::size_t indexCount,
+        std::size_t vertexCount, std::size_t cacheSize,
+        std::vector<std::size_t>* clusters) {
+        std::size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) return;
+
+        // Adjacency [vertex -> triangles using it]
+        std::vector<unsigned int> live(vertexCount, 0);
+        for (std::size_t i = 0; i < indexCount; i++) live[indices[i]]++;
+        std::vector<std::size_t> offsets(vertexCount + 1, 0);
+        for (std::size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + live[v];
+        std::vector<unsigned int> adjacency(indexCount);
+        std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < indexCount; i++) {
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+        }
+
+        std::vector<std::size_t> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> output;
+        output.reserve(indexCount);
+        std::size_t time = cacheSize + 1;
+        std::size_t cursor = 0;
+
+        if (clusters) clusters->assign(1, 0);
+        long fan = indices[0];
+        while (fan >= 0) {
+            candidates.clear();
+            for (std::size_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+                unsigned int t = adjacency[a];
+                if (emitted[t]) continue;
+                for (int k = 0; k < 3; k++) {
+                    unsigned int v = indices[3 * t + k];
+                    output.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = time++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            long next = -1;
+            std::size_t best = 0;
+            for (unsigned int v : candidates) {
+                if (live[v] == 0) continue;
+                std::size_t priority = 0;
+                if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > best) {
+                    best = priority;
+                    next = v;
+                }
+            }
+            if (next < 0) {
+                while (!deadEnd.empty() && next < 0) {
+                    unsigned int v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (live[v] > 0) next = v;
+                }
+                while (next < 0 && cursor < vertexCount) {
+                    if (live[cursor] > 0) next = cursor;
+                    cursor++;
+                }
+                // the cache no longer helps, a new cluster starts here
+                if (next >= 0 && clusters) clusters->push_back(output.size() / 3);
+            }
+            fan = next;
+        }
+        std::copy(output.begin(), output.end(), indices);
+    }
+
+    /////////////////////////////////////////////////////////////////////// OVERDRAW
+
+    void optimizeOverdraw(unsigned int* indices, std::size_t indexCount,
+        const glm::vec3* positions, const std::vector<std::size_t>& clusters) {
+        std::size_t triangleCount = indexCount / 3;
+        if (clusters.size() < 2) return;
+
+        glm::vec3 meshCenter(0.0f);
+        float meshArea = 0.0f;
+        struct Cluster {
+            std::size_t first, last;
+            float sortKey;
+        };
+        std::vector<Cluster> sorted(clusters.size());
+        std::vector<glm::vec3> centers(clusters.size()), normals(clusters.size());
+        for (std::size_t c = 0; c < clusters.size(); c++) {
+            sorted[c].first = clusters[c];
+            sorted[c].last = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            glm::vec3 center(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (std::size_t t = sorted[c].first; t < sorted[c].last; t++) {
+                glm::vec3 a = positions[indices[3 * t]];
+                glm::vec3 b = positions[indices[3 * t + 1]];
+                glm::vec3 d = positions[indices[3 * t + 2]];
+                glm::vec3 n = glm::cross(b - a, d - a);
+                float w = 0.5f * glm::length(n);
+                center += w * (a + b + d) / 3.0f;
+                normal += n;
+                area += w;
+            }
+            meshCenter += center;
+            meshArea += area;
+            centers[c] = area > 0.0f ? center / area : center;
+            float length = glm::length(normal);
+            normals[c] = length > 0.0f ? normal / length : normal;
+        }
+        if (meshArea > 0.0f) meshCenter /= meshArea;
+        for (std::size_t c = 0; c < clusters.size(); c++) {
+            sorted[c].sortKey = glm::dot(centers[c] - meshCenter, normals[c]);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(),
+            [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+        std::vector<unsigned int> output;
+        output.reserve(indexCount);
+        for (const Cluster& cluster : sorted) {
+            output.insert(output.end(), indices + 3 * cluster.first,
+                indices + 3 * cluster.last);
+        }
+        std::copy(output.begin(), output.end(), indices);
+    }
+
+    /////////////////////////////////////////////////////////////////// VERTEX FETCH
+
+    std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices,
+        std::size_t indexCount, std::size_t vertexCount) {
+        const unsigned int unused = 0xFFFFFFFF;
+        std::vector<unsigned int> remap(vertexCount, unused);
+        unsigned int next = 0;
+        for (std::size_t i = 0; i < indexCount; i++) {
+            unsigned int& v = remap[indices[i]];
+            if (v == unused) v = next++;
+            indices[i] = v;
+        }
+        for (unsigned int& v : remap) {
+            if (v == unused) v = next++;
+        }
+        return remap;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Meshlet Functions
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglMeshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mgl {
+
+    //////////////////////////////////////////////////////////////////////// MESHLET
+
+    // Sphere around the box of the vertices; cone around the average of the
+    // triangle normals, opening to the normal furthest from it.
+    static void computeBounds(Meshlet& meshlet, const unsigned int* indices,
+        const glm::vec3* positions) {
+        const unsigned int* first = indices + meshlet.firstIndex;
+        glm::vec3 min = positions[first[0]], max = min;
+        for (unsigned int i = 0; i < meshlet.indexCount; i++) {
+            min = glm::min(min, positions[first[i]]);
+            max = glm::max(max, positions[first[i]]);
+        }
+        meshlet.center = 0.5f * (min + max);
+        float radius = 0.0f;
+        for (unsigned int i = 0; i < meshlet.indexCount; i++) {
+            radius = std::max(radius, glm::length(positions[first[i]] - meshlet.center));
+        }
+        meshlet.radius = radius;
+
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (unsigned int i = 0; i < meshlet.indexCount; i += 3) {
+            glm::vec3 a = positions[first[i]];
+            glm::vec3 n = glm::cross(positions[first[i + 1]] - a, positions[first[i + 2]] - a);
+            float length = glm::length(n);
+            if (length <= 0.0f) continue;
+            normals.push_back(n / length);
+            axis += n / length;
+        }
+        meshlet.coneAxis = glm::vec3(0.0f);
+        meshlet.coneCutoff = 1.0f;
+        float length = glm::length(axis);
+        if (length <= 0.0f) return;
+        axis /= length;
+        float spread = 1.0f;
+        for (const glm::vec3& n : normals) {
+            spread = std::min(spread, glm::dot(axis, n));
+        }
+        // close to a half space or wider there is no eye to cull from
+        if (spread <= 0.1f) return;
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - spread * spread);
+    }
+
+    void buildMeshlets(const unsigned int* indices, size_t indexCount,
+        const glm::vec3* positions, size_t vertexCount, std::vector<Meshlet>& out) {
+        // seen[v] is the meshlet that last used vertex v
+        std::vector<size_t> seen(vertexCount, ~size_t(0));
+        Meshlet meshlet;
+        size_t vertices = 0;
+        for (size_t i = 0; i + 2 < indexCount; i += 3) {
+            size_t added = 0;
+            for (int k = 0; k < 3; k++) {
+                if (seen[indices[i + k]] != out.size()) added++;
+            }
+            if (vertices + added > MESHLET_VERTICES ||
+                meshlet.indexCount / 3 == MESHLET_TRIANGLES) {
+                computeBounds(meshlet, indices, positions);
+                out.push_back(meshlet);
+                meshlet = Meshlet();
+                meshlet.firstIndex = (unsigned int)i;
+                vertices = 0;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (seen[indices[i + k]] != out.size()) {
+                    seen[indices[i + k]] = out.size();
+                    vertices++;
+                }
+            }
+            meshlet.indexCount += 3;
+        }
+        if (meshlet.indexCount > 0) {
+            computeBounds(meshlet, indices, positions);
+            out.push_back(meshlet);
+        }
+    }
+
+    size_t cullMeshlets(const Meshlet* meshlets, size_t count,
+        const glm::mat4& modelViewProjection, const glm::vec3& eye,
+        GLuint firstIndex, GLint baseVertex, DrawCommand* out) {
+        // planes of the model space frustum, normalized in model space so
+        // model space sphere radii can be compared directly
+        glm::mat4 m = glm::transpose(modelViewProjection);
+        glm::vec4 planes[6] = {
+            m[3] + m[0], m[3] - m[0],
+            m[3] + m[1], m[3] - m[1],
+            m[3] + m[2], m[3] - m[2]
+        };
+        for (glm::vec4& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        size_t written = 0;
+        for (size_t i = 0; i < count; i++) {
+            const Meshlet& meshlet = meshlets[i];
+            bool inside = true;
+            for (const glm::vec4& plane : planes) {
+                if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+                    inside = false;
+                    break;
+                }
+            }
+            if (!inside) continue;
+
+            glm::vec3 view = meshlet.center - eye;
+            if (glm::dot(view, meshlet.coneAxis) >=
+                meshlet.coneCutoff * glm::length(view) + meshlet.radius) {
+                continue;
+            }
+
+            DrawCommand& command = out[written++];
+            command.count = meshlet.indexCount;
+            command.instanceCount = 1;
+            command.firstIndex = firstIndex + meshlet.firstIndex;
+            command.baseVertex = baseVertex + (GLint)meshlet.baseVertex;
+            command.baseInstance = 0;
+        }
+        return written;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -38,6 +38,7 @@ namespace mgl {
     void OrbitCamera::windowSize(float winx, float winy) {
         aspect = winx / winy;
         setProjectionMatrix(glm::perspective(glm::radians(fovy), aspect, near, far));
+        Engine::getInstance().requestRedraw();
     }
 
     void OrbitCamera::update() {
@@ -51,7 +52,6 @@ namespace mgl {
         q = qX * qY * q;
 
         Camera::setViewMatrix(glm::translate(T) * glm::toMat4(q));
-        setProjectionMatrix(getProjectionMatrix());
 
         deltaScroll = 0.0f;
         deltaX = 0.0f;
@@ -65,6 +65,7 @@ namespace mgl {
             deltaY += (ypos - prevYpos) * moveStep;
             prevXpos = xpos;
             prevYpos = ypos;
+            Engine::getInstance().requestRedraw();
         }
     }
 
@@ -79,6 +80,7 @@ namespace mgl {
     void OrbitCamera::scroll(double xoffset, double yoffset) {
 
         deltaScroll -= yoffset * zoomStep;
+        Engine::getInstance().requestRedraw();
     }
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Profiler
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglProfiler.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#if defined(MGL_PROFILE_RDTSC)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace mgl {
+
+    /////////////////////////////////////////////////////////////////////////// RING
+
+    Profiler::Ring::Ring(uint32_t tid)
+        : slots(new Slot[RING_SIZE]), head(0), threadId(tid) {
+        for (size_t i = 0; i < RING_SIZE; i++) {
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Fields are relaxed atomics, plain stores on x86; the fences order them
+    // against the sequence.
+    void Profiler::Ring::push(const Sample& sample) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[h & (RING_SIZE - 1)];
+        slot.sequence.store(2 * h + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(sample.name, std::memory_order_relaxed);
+        slot.start.store(sample.start, std::memory_order_relaxed);
+        slot.end.store(sample.end, std::memory_order_relaxed);
+        slot.frame.store(sample.frame, std::memory_order_relaxed);
+        slot.sequence.store(2 * h + 2, std::memory_order_release);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    void Profiler::Ring::copy(std::vector<Sample>& out) {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = end > RING_SIZE ? end - RING_SIZE : 0;
+        for (uint64_t i = begin; i < end; i++) {
+            const Slot& slot = slots[i & (RING_SIZE - 1)];
+            uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * i + 2) continue;
+            Sample sample;
+            sample.name = slot.name.load(std::memory_order_relaxed);
+            sample.start = slot.start.load(std::memory_order_relaxed);
+            sample.end = slot.end.load(std::memory_order_relaxed);
+            sample.frame = slot.frame.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // rewritten while being read
+            if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+            out.push_back(sample);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////// PROFILER
+
+    Profiler::Profiler() : frame(0), gpuRing(0), gpuBase(0), cpuBase(0) {
+#if defined(MGL_PROFILE_RDTSC)
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t r0 = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t r1 = now();
+        auto t1 = std::chrono::steady_clock::now();
+        ticksPerMicrosecond =
+            (r1 - r0) / std::chrono::duration<double, std::micro>(t1 - t0).count();
+#else
+        ticksPerMicrosecond = 1000.0;
+#endif
+    }
+
+    Profiler::~Profiler() {}
+
+    Profiler& Profiler::getInstance() {
+        static Profiler instance;
+        return instance;
+    }
+
+    uint64_t Profiler::now() {
+#if defined(MGL_PROFILE_RDTSC)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    Profiler::Ring* Profiler::getRing() {
+        thread_local Ring* ring = 0;
+        if (!ring) {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.emplace_back(new Ring(rings.size()));
+            ring = rings.back().get();
+        }
+        return ring;
+    }
+
+    uint32_t Profiler::getFrame() { return frame.load(std::memory_order_relaxed); }
+
+    void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+        getRing()->push({ name, start, end, getFrame() });
+    }
+
+    //////////////////////////////////////////////////////////////////////////// GPU
+
+    void Profiler::setupGpu() {
+        for (GpuFrame& gpu : gpuFrames) {
+            gpu.queries.resize(2 * GPU_QUERIES);
+            gpu.names.resize(GPU_QUERIES);
+            glGenQueries(2 * GPU_QUERIES, gpu.queries.data());
+        }
+        // align the gpu clock with ours once; drift is ignored
+        glGetInteger64v(GL_TIMESTAMP, &gpuBase);
+        cpuBase = now();
+
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.emplace_back(new Ring(rings.size()));
+        gpuRing = rings.back().get();
+    }
+
+    int Profiler::beginGpu(const char* name) {
+        if (!gpuRing) setupGpu();
+        GpuFrame& gpu = gpuFrames[getFrame() % GPU_LATENCY];
+        if (gpu.count >= GPU_QUERIES) return -1;
+        unsigned int query = gpu.count++;
+        gpu.names[query] = name;
+        glQueryCounter(gpu.queries[2 * query], GL_TIMESTAMP);
+        return query;
+    }
+
+    void Profiler::endGpu(int query) {
+        if (query < 0) return;
+        GpuFrame& gpu = gpuFrames[getFrame() % GPU_LATENCY];
+        glQueryCounter(gpu.queries[2 * query + 1], GL_TIMESTAMP);
+    }
+
+    void Profiler::collectGpu(GpuFrame& gpu) {
+        double ticksPerNanosecond = ticksPerMicrosecond / 1000.0;
+        for (unsigned int i = 0; i < gpu.count; i++) {
+            GLint available = 0;
+            glGetQueryObjectiv(gpu.queries[2 * i + 1], GL_QUERY_RESULT_AVAILABLE,
+                &available);
+            // still in flight after GPU_LATENCY frames: drop it, never wait
+            if (!available) continue;
+            GLuint64 start, end;
+            glGetQueryObjectui64v(gpu.queries[2 * i], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(gpu.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            gpuRing->push({ gpu.names[i],
+                cpuBase + uint64_t((int64_t(start) - gpuBase) * ticksPerNanosecond),
+                cpuBase + uint64_t((int64_t(end) - gpuBase) * ticksPerNanosecond),
+                gpu.frame });
+        }
+        gpu.count = 0;
+    }
+
+    void Profiler::beginFrame() {
+        uint32_t next = frame.load(std::memory_order_relaxed) + 1;
+        GpuFrame& gpu = gpuFrames[next % GPU_LATENCY];
+        if (gpuRing) collectGpu(gpu);
+        gpu.frame = next;
+        frame.store(next, std::memory_order_relaxed);
+    }
+
+    /////////////////////////////////////////////////////////////////////////// DUMP
+
+    // Chrome trace-event format, loadable in chrome://tracing or Perfetto.
+    void Profiler::dump(const std::string& filename, uint32_t first, uint32_t last) {
+        std::ofstream file(filename);
+        file << std::fixed << std::setprecision(3);
+        file << "{\"traceEvents\":[\n";
+        bool comma = false;
+
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (auto& ring : rings) {
+            const char* track = ring.get() == gpuRing ? "GPU" : "CPU";
+            file << (comma ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\","
+                << "\"pid\":0,\"tid\":" << ring->threadId << ",\"args\":{\"name\":\""
+                << track << " " << ring->threadId << "\"}}";
+            comma = true;
+
+            std::vector<Sample> samples;
+            ring->copy(samples);
+            for (const Sample& s : samples) {
+                if (s.frame < first || s.frame > last) continue;
+                file << ",\n{\"name\":\"" << s.name << "\",\"cat\":\"" << track
+                    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->threadId
+                    << ",\"ts\":" << s.start / ticksPerMicrosecond
+                    << ",\"dur\":" << (s.end - s.start) / ticksPerMicrosecond
+                    << ",\"args\":{\"frame\":" << s.frame << "}}";
+            }
+        }
+        file << "\n]}\n";
+        std::cout << "trace of frames " << first << "-" << last << " saved on: "
+            << filename << std::endl;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
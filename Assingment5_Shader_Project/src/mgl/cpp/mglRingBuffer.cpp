@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Transient GPU Ring Buffer Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglRingBuffer.hpp"
+
+#include <iostream>
+
+namespace mgl {
+
+    //////////////////////////////////////////////////////////////////// RING BUFFER
+
+    RingBuffer::RingBuffer() {
+        BufferId = 0;
+        Mapped = nullptr;
+        Persistent = false;
+        RegionSize = 0, Head = 0;
+        Alignment = 256;
+        Current = 0;
+        for (GLsync& fence : Fences) fence = 0;
+        Stalls = 0;
+    }
+
+    RingBuffer::~RingBuffer() {}
+
+    RingBuffer& RingBuffer::getInstance() {
+        static RingBuffer instance;
+        return instance;
+    }
+
+    void RingBuffer::create(GLsizeiptr regionsize) {
+        destroy();
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &Alignment);
+        RegionSize = (regionsize + Alignment - 1) / Alignment * Alignment;
+        GLsizeiptr size = REGIONS * RegionSize;
+
+        glGenBuffers(1, &BufferId);
+        glBindBuffer(GL_UNIFORM_BUFFER, BufferId);
+        Persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+        if (Persistent) {
+            GLbitfield flags =
+                GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_UNIFORM_BUFFER, size, 0, flags);
+            Mapped = static_cast<unsigned char*>(
+                glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+            if (!Mapped) {
+                std::cerr << "ERROR: ring buffer could not be mapped" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else {
+            glBufferData(GL_UNIFORM_BUFFER, size, 0, GL_STREAM_DRAW);
+            Staging.resize(size);
+            Mapped = Staging.data();
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        Current = 0, Head = 0;
+    }
+
+    void RingBuffer::destroy() {
+        if (!BufferId) return;
+        for (GLsync& fence : Fences) {
+            if (fence) glDeleteSync(fence);
+            fence = 0;
+        }
+        if (Persistent) {
+            glBindBuffer(GL_UNIFORM_BUFFER, BufferId);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &BufferId);
+        BufferId = 0;
+        Mapped = nullptr;
+        Staging.clear();
+    }
+
+    void RingBuffer::beginFrame() {
+        if (!BufferId) create(1 << 20);
+        advance();
+    }
+
+    void RingBuffer::endFrame() {
+        if (BufferId) fence();
+    }
+
+    RingBuffer::Allocation RingBuffer::allocate(GLsizeiptr size) {
+        if (!BufferId) create(1 << 20);
+        GLsizeiptr aligned = (size + Alignment - 1) / Alignment * Alignment;
+        if (aligned > RegionSize) {
+            std::cerr << "ERROR: ring buffer allocation of " << size
+                << " bytes is larger than a region" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (Head + aligned > RegionSize) {
+            fence();
+            advance();
+        }
+        Allocation allocation;
+        allocation.offset = Current * RegionSize + Head;
+        allocation.data = Mapped + allocation.offset;
+        allocation.buffer = BufferId;
+        allocation.size = size;
+        Head += aligned;
+        return allocation;
+    }
+
+    void RingBuffer::bind(GLuint bindingpoint, const Allocation& allocation) {
+        flush(allocation);
+        glBindBufferRange(GL_UNIFORM_BUFFER, bindingpoint, allocation.buffer,
+            allocation.offset, allocation.size);
+    }
+
+    // For non-indexed targets, such as GL_DRAW_INDIRECT_BUFFER, where the
+    // allocation offset is passed to the call that reads the buffer.
+    void RingBuffer::bindBuffer(GLenum target, const Allocation& allocation) {
+        flush(allocation);
+        glBindBuffer(target, allocation.buffer);
+    }
+
+    void RingBuffer::flush(const Allocation& allocation) {
+        if (Persistent) return;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, allocation.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size,
+            allocation.data);
+    }
+
+    GLsizeiptr RingBuffer::getRegionSize() { return RegionSize; }
+
+    // Times the CPU had to wait for the GPU to release a region.
+    size_t RingBuffer::getStalls() { return Stalls; }
+
+    void RingBuffer::advance() {
+        Current = (Current + 1) % REGIONS;
+        wait(Current);
+        Head = 0;
+    }
+
+    void RingBuffer::fence() {
+        if (Fences[Current]) glDeleteSync(Fences[Current]);
+        Fences[Current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void RingBuffer::wait(int region) {
+        GLsync fence = Fences[region];
+        if (!fence) return;
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            Stalls++;
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        Fences[region] = 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
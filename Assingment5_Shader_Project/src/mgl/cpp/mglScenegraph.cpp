@@ -6,11 +6,18 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <limits>
 #include <sstream>
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include "mglScenegraph.hpp"
+#include "mglGpuScene.hpp"
 #include "mglManager.hpp"
 #include "mglKeyBuffer.hpp"
+#include "mglProfiler.hpp"
+#include "mglSnapshot.hpp"
+#include "mglStaticBatch.hpp"
 
 namespace mgl {
 
@@ -66,13 +73,21 @@ namespace mgl {
 		this->path = "./assets/scenegraphs/" + path + ".txt";
 	}
 
-	Scenegraph::~Scenegraph() {}
+	Scenegraph::~Scenegraph() {
+		clear();
+		nodePool.release();
+		delete camera;
+		delete frame;
+		delete gpuScene;
+		delete staticBatch;
+	}
 
 	std::string Scenegraph::getPath() {
 		return path;
 	}
 
 	void Scenegraph::createCamera(GLuint bindingpoint) {
+		delete camera;
 		camera = new mgl::OrbitCamera(bindingpoint);
 	}
 
@@ -81,6 +96,7 @@ namespace mgl {
 		viewMatrix[1] = center;
 		viewMatrix[2] = up;
 		camera->setViewMatrix(eye, center, up);
+		Engine::getInstance().requestRedraw();
 	}
 
 	glm::vec3 Scenegraph::getEye() {
@@ -108,20 +124,183 @@ namespace mgl {
 		projectionMatrix[2] = near;
 		projectionMatrix[3] = far;
 		camera->setPerspectiveMatrix(fovy, aspect, near, far);
+		Engine::getInstance().requestRedraw();
 	}
 
 	void Scenegraph::setLight(glm::vec3 light) {
 		this->light = light;
+		Engine::getInstance().requestRedraw();
 	}
 
 	glm::vec3 Scenegraph::getLight() {
 		return light;
 	}
 
-	void Scenegraph::addNode(SceneNode* node) {
+	SceneNode* Scenegraph::createNode() {
+		NodeHandle handle;
+		if (freeHandles.empty()) {
+			handle.slot = handles.size();
+			handles.push_back(HandleSlot());
+		}
+		else {
+			handle.slot = freeHandles.back();
+			freeHandles.pop_back();
+		}
+		handle.generation = handles[handle.slot].generation;
+		handles[handle.slot].index = nodes.size();
+
+		SceneNode* node = nodePool.create();
 		node->setRoot(this);
 		node->setIndex(nodes.size());
+		node->setHandle(handle);
 		nodes.push_back(node);
+		markChanged(nodes.size() - 1);
+		Engine::getInstance().requestRedraw();
+		return node;
+	}
+
+	SceneNode* Scenegraph::getNode(NodeHandle handle) {
+		if (handle.slot >= handles.size()) return nullptr;
+		HandleSlot& slot = handles[handle.slot];
+		if (slot.index < 0 || slot.generation != handle.generation) return nullptr;
+		return nodes[slot.index];
+	}
+
+	// Swap-and-pop: the last node takes the removed node's place, so draw
+	// order changes but removal is O(1).
+	bool Scenegraph::removeNode(NodeHandle handle) {
+		SceneNode* node = getNode(handle);
+		if (!node) return false;
+
+		if (staticBatch) staticBatch->remove(handle);
+		int index = handles[handle.slot].index;
+		SceneNode* last = nodes.back();
+		nodes[index] = last;
+		last->setIndex(index);
+		handles[last->getHandle().slot].index = index;
+		nodes.pop_back();
+		if (index < (int)nodes.size()) markChanged(index);
+
+		handles[handle.slot].index = -1;
+		handles[handle.slot].generation++;
+		freeHandles.push_back(handle.slot);
+		nodePool.destroy(node);
+		Engine::getInstance().requestRedraw();
+		return true;
+	}
+
+	void Scenegraph::clear() {
+		for (auto& node : nodes) {
+			HandleSlot& slot = handles[node->getHandle().slot];
+			slot.index = -1;
+			slot.generation++;
+			freeHandles.push_back(node->getHandle().slot);
+			nodePool.destroy(node);
+		}
+		nodes.clear();
+		if (staticBatch) staticBatch->clear();
+		selected = NodeHandle();
+		Engine::getInstance().requestRedraw();
+	}
+
+	size_t Scenegraph::getNodeCount() {
+		return nodes.size();
+	}
+
+	const glm::mat4& Scenegraph::getWorldMatrix(int index) {
+		return worldMatrices[index];
+	}
+
+	const glm::mat3& Scenegraph::getNormalMatrix(int index) {
+		return normalMatrices[index];
+	}
+
+	FrameConstants& Scenegraph::getFrameConstants() {
+		return *frame;
+	}
+
+	// Draws through a GpuScene culled by culling, the program built from
+	// cull-cs.glsl; null goes back to drawing node by node. Not for
+	// threaded apps, whose snapshots are drawn item by item.
+	bool Scenegraph::setGpuDriven(ShaderProgram* culling) {
+		delete gpuScene;
+		gpuScene = nullptr;
+		changedNodes.clear();
+		changed.clear();
+		Engine::getInstance().requestRedraw();
+		if (!culling) return true;
+		if (!GpuScene::isSupported()) {
+			std::cerr << "WARNING: GPU-driven drawing needs OpenGL 4.6." << std::endl;
+			return false;
+		}
+		gpuScene = new GpuScene(culling);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			markChanged(i);
+		}
+		return true;
+	}
+
+	bool Scenegraph::isGpuDriven() {
+		return gpuScene != nullptr;
+	}
+
+	// Static nodes are drawn from chunks baked with shader, chunkSize wide
+	// in world space, instead of node by node; their meshes must keep their
+	// arrays. Null goes back to drawing every node. Not for threaded apps.
+	void Scenegraph::setStaticBatching(ShaderProgram* shader, float chunkSize) {
+		delete staticBatch;
+		staticBatch = nullptr;
+		Engine::getInstance().requestRedraw();
+		if (!shader) return;
+		staticBatch = new StaticBatch(shader, chunkSize);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			markChanged(i);
+		}
+	}
+
+	bool Scenegraph::isStaticBatching() {
+		return staticBatch != nullptr;
+	}
+
+	// Nodes are written to the GPU scene, and static chunks baked again, by
+	// the next update().
+	void Scenegraph::markChanged(int index) {
+		if (staticBatch) staticBatch->place(nodes[index]);
+		if (!gpuScene) return;
+		if (changed.size() <= (size_t)index) changed.resize(index + 1, 0);
+		if (changed[index]) return;
+		changed[index] = 1;
+		changedNodes.push_back(index);
+	}
+
+	void Scenegraph::syncGpuScene() {
+		gpuScene->resize(nodes.size());
+		for (int index : changedNodes) {
+			changed[index] = 0;
+			if (index >= (int)nodes.size()) continue;
+			SceneNode* node = nodes[index];
+			Mesh* mesh = staticBatch && node->isStatic() ? nullptr : node->getMesh();
+			gpuScene->setNode(index, node->getTranslation(), node->getRotation(),
+				node->getScaling(), node->getColor(), mesh, node->getShader());
+		}
+		changedNodes.clear();
+	}
+
+	void Scenegraph::updateTransforms() {
+		size_t n = nodes.size();
+		translations.resize(n);
+		rotations.resize(n);
+		scales.resize(n);
+		worldMatrices.resize(n);
+		normalMatrices.resize(n);
+
+		for (size_t i = 0; i < n; i++) {
+			translations[i] = nodes[i]->getTranslation();
+			rotations[i] = nodes[i]->getRotation();
+			scales[i] = nodes[i]->getScaling();
+		}
+		composeTransforms(n, translations.data(), rotations.data(), scales.data(),
+			worldMatrices.data(), normalMatrices.data());
 	}
 
 	void Scenegraph::save() {
@@ -185,12 +364,12 @@ namespace mgl {
 		light = read_vec3(file);
 
 		// Nodes
+		clear();
 		while (std::getline(file, line)) {
-			mgl::SceneNode* node = new mgl::SceneNode();
-			node->load(file);
-			addNode(node);
+			createNode()->load(file);
 		}
 		file.close();
+		Engine::getInstance().requestRedraw();
 		std::cout << "scenegraph loaded from: " << path << std::endl;
 		return true;
 	}
@@ -199,23 +378,191 @@ namespace mgl {
 		if (button == GLFW_MOUSE_BUTTON_1 && action == GLFW_RELEASE) {
 			double xpos, ypos;
 			int height;
+			GLuint nodeID = 0;
 			glfwGetCursorPos(win, &xpos, &ypos);
 			glfwGetWindowSize(win, NULL, &height);
+			if (gpuScene) {
+				select(pickSphere(xpos, height - ypos));
+				return;
+			}
+			if (Engine::getInstance().isThreaded()) {
+				// the stencil lives on the render thread, the answer comes back through select()
+				RenderEvent event = { RenderEvent::PICK, xpos, height - ypos };
+				Engine::getInstance().postRenderEvent(event);
+				return;
+			}
 			glReadPixels(xpos, height - ypos, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_INT, &nodeID);
-			std::cout << "picked object" << nodeID << std::endl;
+			if (nodeID == 0 && staticBatch && staticBatch->getNodeCount() > 0) {
+				// static chunks draw with stencil 0, as does the background,
+				// so only the batched nodes are worth testing
+				select(pickSphere(xpos, height - ypos, true));
+				return;
+			}
+			select(nodeID > 0 && nodeID <= nodes.size() ? nodes[nodeID - 1]->getHandle() : NodeHandle());
 		}
 	}
 
-	void Scenegraph::draw() {
+	// GPU-driven frames and static chunks draw their nodes with the same
+	// stencil value, so the ray under the cursor is tested against the node bounding spheres.
+	// staticOnly leaves out the nodes that draw with their own stencil ID.
+	NodeHandle Scenegraph::pickSphere(double xpos, double ypos, bool staticOnly) {
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glm::vec4 window(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glm::mat4 view = camera->getViewMatrix();
+		glm::mat4 projection = camera->getProjectionMatrix();
+		glm::vec3 origin = glm::unProject(glm::vec3(xpos, ypos, 0.0f), view, projection, window);
+		glm::vec3 target = glm::unProject(glm::vec3(xpos, ypos, 1.0f), view, projection, window);
+		glm::vec3 direction = glm::normalize(target - origin);
+
+		updateTransforms();
+		NodeHandle picked;
+		float nearest = std::numeric_limits<float>::max();
+		for (size_t i = 0; i < nodes.size(); i++) {
+			Mesh* mesh = nodes[i]->getMesh();
+			if (!mesh || (staticOnly && !nodes[i]->isStatic())) continue;
+
+			glm::vec3 center = glm::vec3(worldMatrices[i] * glm::vec4(mesh->getCenter(), 1.0f));
+			glm::vec3 scale = glm::abs(scales[i]);
+			float radius = mesh->getRadius() * glm::max(scale.x, glm::max(scale.y, scale.z));
+
+			// closest point of the ray to the center, then back to the sphere
+			glm::vec3 offset = center - origin;
+			float along = glm::dot(offset, direction);
+			float miss = glm::dot(offset, offset) - along * along;
+			if (miss > radius * radius) continue;
+			float half = std::sqrt(radius * radius - miss);
+			if (along + half < 0.0f) continue;
+			float distance = glm::max(along - half, 0.0f);
+			if (distance < nearest) {
+				nearest = distance;
+				picked = nodes[i]->getHandle();
+			}
+		}
+		return picked;
+	}
+
+	void Scenegraph::select(NodeHandle handle) {
+		selected = handle;
+		if (getNode(selected)) {
+			std::cout << "picked object" << handles[selected.slot].index + 1 << std::endl;
+		}
+		else {
+			std::cout << "picked object0" << std::endl;
+		}
+	}
+
+	void Scenegraph::update() {
+		MGL_PROFILE_SCOPE("Scenegraph::update")
+		camera->update();
+		if (staticBatch) staticBatch->rebuild(this);
+		if (gpuScene) {
+			syncGpuScene();
+			return;
+		}
+		updateTransforms();
+	}
+
+	void Scenegraph::cull() {
+		MGL_PROFILE_SCOPE("Scenegraph::cull")
+		if (gpuScene) {
+			gpuScene->cull(camera->getViewMatrix(), camera->getProjectionMatrix(), getEye());
+			return;
+		}
+		// frustum planes from the rows of the view-projection matrix
+		glm::mat4 m = glm::transpose(camera->getProjectionMatrix() * camera->getViewMatrix());
+		glm::vec4 planes[6] = {
+			m[3] + m[0], m[3] - m[0],
+			m[3] + m[1], m[3] - m[1],
+			m[3] + m[2], m[3] - m[2]
+		};
+		for (auto& plane : planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		visibleNodes.clear();
+		for (size_t i = 0; i < nodes.size(); i++) {
+			Mesh* mesh = nodes[i]->getMesh();
+			if (!mesh) continue;
+			if (staticBatch && nodes[i]->isStatic()) continue;
+
+			glm::vec3 center = glm::vec3(worldMatrices[i] * glm::vec4(mesh->getCenter(), 1.0f));
+			glm::vec3 scale = glm::abs(scales[i]);
+			float radius = mesh->getRadius() * glm::max(scale.x, glm::max(scale.y, scale.z));
+
+			bool inside = true;
+			for (auto& plane : planes) {
+				if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+					inside = false;
+					break;
+				}
+			}
+			if (inside) visibleNodes.push_back(i);
+		}
+	}
+
+	void Scenegraph::submit() {
+		MGL_PROFILE_SCOPE("Scenegraph::submit")
+		camera->upload();
+		if (!frame) frame = new FrameConstants();
+		frame->light = light;
+		frame->eye = getEye();
+		frame->viewProjection = camera->getProjectionMatrix() * camera->getViewMatrix();
+		frame->block = RingBuffer::Allocation();
+		if (gpuScene) {
+			gpuScene->draw(*frame);
+			if (staticBatch) staticBatch->draw(frame->viewProjection, *frame);
+			return;
+		}
+
 		glEnable(GL_STENCIL_TEST);
 		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-		camera->update();
-		for (auto &node : nodes) {
-			node->draw();
+		for (int index : visibleNodes) {
+			nodes[index]->draw();
 		}
+		if (staticBatch) staticBatch->draw(frame->viewProjection, *frame);
 		glDisable(GL_STENCIL_TEST);
 	}
 
+	void Scenegraph::draw() {
+		MGL_PROFILE_SCOPE("Scenegraph::draw")
+		MGL_PROFILE_GPU_SCOPE("Scenegraph::draw")
+		update();
+		cull();
+		submit();
+	}
+
+	// Main thread side of a threaded app: runs update and cull, then copies
+	// what submit() would draw. Reuses the storage already in out.
+	void Scenegraph::snapshot(SceneSnapshot& out) {
+		MGL_PROFILE_SCOPE("Scenegraph::snapshot")
+		update();
+		cull();
+		out.view = camera->getViewMatrix();
+		out.projection = camera->getProjectionMatrix();
+		out.bindingPoint = camera->getBindingPoint();
+		out.eye = getEye();
+		out.light = light;
+		out.items.resize(visibleNodes.size());
+		for (size_t i = 0; i < visibleNodes.size(); i++) {
+			int index = visibleNodes[i];
+			DrawItem& item = out.items[i];
+			item.mesh = nodes[index]->getMesh();
+			// resolved by the renderer, which may have to build the variant
+			item.shaderKey = nodes[index]->getShaderID();
+			item.shaderFeatures = item.mesh ? item.mesh->getShaderFeatures() : 0;
+			item.world = worldMatrices[index];
+			item.normal = normalMatrices[index];
+			item.color = nodes[index]->getColor();
+			item.handle = nodes[index]->getHandle();
+		}
+	}
+
+	// Nodes the CPU cull kept; a GPU scene culls without reading back.
+	size_t Scenegraph::getVisibleCount() {
+		return visibleNodes.size();
+	}
+
 	void Scenegraph::windowSizeCallback(GLFWwindow* win, int winx, int winy) {
 		// change projection matrices to maintain aspect ratio
 		camera->windowSize(winx, winy);
@@ -242,7 +589,7 @@ namespace mgl {
 				std::cout << "pick mode activated" << std::endl;
 				break;
 			case GLFW_KEY_R:
-				if (nodeID <= 0) {
+				if (!getNode(selected)) {
 					std::cout << "no item selected" << std::endl;
 					break;
 				}
@@ -250,7 +597,7 @@ namespace mgl {
 				std::cout << "rotate mode activated" << std::endl;
 				break;
 			case GLFW_KEY_S:
-				if (nodeID <= 0) {
+				if (!getNode(selected)) {
 					std::cout << "no item selected" << std::endl;
 					break;
 				}
@@ -258,13 +605,21 @@ namespace mgl {
 				std::cout << "scale mode activated" << std::endl;
 				break;
 			case GLFW_KEY_T:
-				if (nodeID <= 0) {
+				if (!getNode(selected)) {
 					std::cout << "no item selected" << std::endl;
 					break;
 				}
 				mode = Mode::TRANSLATE;
 				std::cout << "translate mode activated" << std::endl;
 				break;
+			case GLFW_KEY_DELETE:
+				if (!removeNode(selected)) {
+					std::cout << "no item selected" << std::endl;
+					break;
+				}
+				mode = Mode::NONE;
+				std::cout << "node removed" << std::endl;
+				break;
 			default:
 				break;
 			}
@@ -278,12 +633,12 @@ namespace mgl {
 			camera->cursor(xpos, ypos);
 			break;
 		case Mode::ROTATE:
-			if (!leftClick) break;
-			nodes[nodeID - 1]->rotate(xpos - xprev, ypos - yprev);
+			if (!leftClick || !getNode(selected)) break;
+			getNode(selected)->rotate(xpos - xprev, ypos - yprev);
 				break;
 		case Mode::TRANSLATE:
-			if (!leftClick) break;
-			nodes[nodeID - 1]->translate(xpos - xprev, ypos - yprev);
+			if (!leftClick || !getNode(selected)) break;
+			getNode(selected)->translate(xpos - xprev, ypos - yprev);
 				break;
 		default:
 			break;
@@ -316,7 +671,8 @@ namespace mgl {
 			camera->scroll(xoffset, yoffset);
 			break;
 		case Mode::SCALE:
-			nodes[nodeID-1]->scale(yoffset);
+			if (!getNode(selected)) break;
+			getNode(selected)->scale(yoffset);
 		default:
 			break;
 		}
@@ -328,6 +684,12 @@ namespace mgl {
 
 	SceneNode::~SceneNode() {}
 
+	// Drawn on the next frame, and written again to a GPU scene.
+	void SceneNode::changed() {
+		root->markChanged(index);
+		Engine::getInstance().requestRedraw();
+	}
+
 	void SceneNode::setRoot(Scenegraph* root) {
 		this->root = root;
 	}
@@ -336,49 +698,123 @@ namespace mgl {
 		this->index = index;
 	}
 
+	void SceneNode::setHandle(NodeHandle handle) {
+		this->handle = handle;
+	}
+
+	NodeHandle SceneNode::getHandle() {
+		return handle;
+	}
+
 	void SceneNode::setModelMatrix(glm::mat4 scale, glm::mat4 rotate, glm::mat4 translate) {
-		modelMatrix[0] = scale;
-		modelMatrix[1] = rotate;
-		modelMatrix[2] = translate;
+		scaling = glm::vec3(scale[0][0], scale[1][1], scale[2][2]);
+		rotation = glm::toQuat(rotate);
+		translation = glm::vec3(translate[3]);
+		changed();
 	}
 
 	void SceneNode::updateModelMatrix(glm::mat4 scale, glm::mat4 rotate, glm::mat4 translate) {
-		modelMatrix[0] = scale * modelMatrix[0];
-		modelMatrix[1] = rotate * modelMatrix[1];
-		modelMatrix[2] = translate * modelMatrix[2];
+		scaling = glm::vec3(scale[0][0], scale[1][1], scale[2][2]) * scaling;
+		rotation = glm::toQuat(rotate) * rotation;
+		translation = glm::vec3(translate[3]) + translation;
+		changed();
+	}
+
+	void SceneNode::setTransform(glm::vec3 scaling, glm::quat rotation, glm::vec3 translation) {
+		this->scaling = scaling;
+		this->rotation = rotation;
+		this->translation = translation;
+		changed();
+	}
+
+	const glm::vec3& SceneNode::getScaling() {
+		return scaling;
+	}
+
+	const glm::quat& SceneNode::getRotation() {
+		return rotation;
+	}
+
+	const glm::vec3& SceneNode::getTranslation() {
+		return translation;
 	}
 
 	void SceneNode::setColor(glm::vec3 color) {
 		this->color = color;
+		changed();
+	}
+
+	const glm::vec3& SceneNode::getColor() {
+		return color;
 	}
 
 	void SceneNode::setMesh(std::string meshID) {
 		this->meshID = meshID;
+		mesh = nullptr;
+		shader = nullptr;
+		root->markChanged(index);
+	}
+
+	Mesh* SceneNode::getMesh() {
+		if (!mesh) {
+			mesh = MeshManager::getInstance().get(meshID);
+		}
+		return mesh;
 	}
 
 	void SceneNode::setShader(std::string shaderID) {
 		this->shaderID = shaderID;
+		shader = nullptr;
+		root->markChanged(index);
+	}
+
+	const std::string& SceneNode::getShaderID() {
+		return shaderID;
+	}
+
+	// Shaders with variants draw each mesh with the one for its features,
+	// so nothing is resolved before the mesh is loaded. Context thread only,
+	// as it may build the variant.
+	ShaderProgram* SceneNode::getShader() {
+		if (!shader) {
+			Mesh* mesh = getMesh();
+			if (!mesh) return nullptr;
+			shader = ShaderManager::getInstance().get(shaderID, mesh->getShaderFeatures());
+		}
+		return shader;
+	}
+
+	void SceneNode::setStatic(bool staticFlag) {
+		this->staticFlag = staticFlag;
+		changed();
+	}
+
+	bool SceneNode::isStatic() {
+		return staticFlag;
 	}
 
 	void SceneNode::save(std::ofstream& file) {
 		file << "Node" << std::endl;
-		file << "scale:\n" << mat4_to_string(modelMatrix[0]) << std::endl;
-		file << "rotate:\n" << mat4_to_string(modelMatrix[1]) << std::endl;
-		file << "translate:\n" << mat4_to_string(modelMatrix[2]) << std::endl;
+		file << "scale:\n" << mat4_to_string(glm::scale(scaling)) << std::endl;
+		file << "rotate:\n" << mat4_to_string(glm::toMat4(rotation)) << std::endl;
+		file << "translate:\n" << mat4_to_string(glm::translate(translation)) << std::endl;
 		file << "color:\n" << vec3_to_string(color) << std::endl;
 		file << "meshID:\n" << meshID << std::endl;
 		file << "shaderID:\n" << shaderID << std::endl;
+		file << "static:\n" << (staticFlag ? 1 : 0) << std::endl;
 	}
 
 	void SceneNode::load(std::ifstream& file) {
 		std::string line;
 
 		// Model Matrix
+		glm::mat4 modelMatrix[3];
 		for (auto& param : modelMatrix) {
 			// name
 			std::getline(file, line);
 			param = read_mat4(file);
 		}
+		setModelMatrix(modelMatrix[0], modelMatrix[1], modelMatrix[2]);
 
 		// Color
 		std::getline(file, line);
@@ -388,11 +824,25 @@ namespace mgl {
 		std::getline(file, line);
 		std::getline(file, line);
 		meshID = line;
+		mesh = nullptr;
 
 		// ShaderID
 		std::getline(file, line);
 		std::getline(file, line);
 		shaderID = line;
+		shader = nullptr;
+
+		// Static [optional, older files end at the shaderID]
+		std::streampos next = file.tellg();
+		if (std::getline(file, line) && line == "static:") {
+			std::getline(file, line);
+			staticFlag = line == "1";
+		}
+		else {
+			file.clear();
+			file.seekg(next);
+		}
+		changed();
 	}
 
 	void SceneNode::scale(double amount) {
@@ -407,16 +857,18 @@ namespace mgl {
 		else if (keys.pressed[GLFW_KEY_Z]) sVector.z = sFactor;
 		else sVector = glm::vec3(sFactor);
 
-		modelMatrix[0] = glm::scale(sVector) * modelMatrix[0];
+		scaling = sVector * scaling;
+		changed();
 	}
 
 	void SceneNode::rotate(double xamount, double yamount) {
-		glm::quat q = glm::toQuat(modelMatrix[1]);
+		glm::quat q = rotation;
 
 		q = glm::angleAxis((float)(xamount * rotStep), root->getU()) * q;
 		q = glm::angleAxis((float)(yamount * rotStep), root->getS()) * q;
 
-		modelMatrix[1] = glm::toMat4(q);
+		rotation = glm::normalize(q);
+		changed();
 	}
 
 	void SceneNode::translate(double xamount, double yamount) {
@@ -432,34 +884,19 @@ namespace mgl {
 		else if (keys.pressed[GLFW_KEY_Z]) res.z = t.z;
 		else res = t;
 		
-		modelMatrix[2] = glm::translate(res) * modelMatrix[2];
+		translation = res + translation;
+		changed();
 	}
 
 	void SceneNode::draw() {
-		glStencilFunc(GL_ALWAYS, index + 1, 0xFF);
-
-		ShaderProgram* shader = ShaderManager::getInstance().get(shaderID);
-
-		shader->bind();
-
-		GLint ModelMatrixId = shader->Uniforms[mgl::MODEL_MATRIX].index;
-		glm::mat4 model = modelMatrix[2] * modelMatrix[1] * modelMatrix[0];
-		glUniformMatrix4fv(ModelMatrixId, 1, GL_FALSE, glm::value_ptr(model));
-
-		GLint ColorId = shader->Uniforms[mgl::COLOR_ATTRIBUTE].index;
-		glUniform3f(ColorId, color.x, color.y, color.z);
-
-		GLint LightPositionId = shader->Uniforms[mgl::LIGHT_POSITION].index;
-		glm::vec3 light = root->getLight();
-		glUniform3f(LightPositionId, light.x, light.y, light.z);
-
-		GLint EyePositionId = shader->Uniforms[mgl::EYE_POSITION].index;
-		glm::vec3 eye = root->getEye();
-		glUniform3f(EyePositionId, eye.x, eye.y, eye.z);
-
-		MeshManager::getInstance().get(meshID)->draw();
-
-		shader->unbind();
+		MGL_PROFILE_SCOPE("SceneNode::draw")
+		DrawItem item;
+		item.mesh = getMesh();
+		item.world = root->getWorldMatrix(index);
+		item.normal = root->getNormalMatrix(index);
+		item.color = color;
+		item.handle = handle;
+		drawItem(item, getShader(), root->getFrameConstants(), index + 1);
 	}
 
 	////////////////////////////////////////////////////////////////////////////////
@@ -3,29 +3,235 @@
 // Shader Program Class
 //
 // Copyright (c)2022-23 by Carlos Martinho
+// 
+// modified by Joo Baracho
 //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "./mglShader.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <numeric>
+#include <vector>
+
+#include "./mglFile.hpp"
 
 namespace mgl {
 
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    // Cached program file: this header, then the driver's binary.
+    struct ProgramBinaryHeader {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::uint32_t format;
+        std::uint32_t length;
+        // what compiling and linking took, to report the time a hit saves
+        double compileSeconds;
+    };
+
+    static const std::uint32_t PROGRAM_BINARY_VERSION = 1;
+
+    static bool isBinaryCacheSupported() {
+        if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    static double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The quoted name of an #include line.
+    static bool parseInclude(const std::string& line, std::string& name) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include")) return false;
+        size_t open = line.find('"', start + 8);
+        if (open == std::string::npos) return false;
+        size_t close = line.find('"', open + 1);
+        if (close == std::string::npos) return false;
+        name = line.substr(open + 1, close - open - 1);
+        return true;
+    }
+
+    // #line gives the number of the next line from GLSL 4.30 on, and of
+    // the line itself before; directives are written the new way.
+    static std::string adjustLines(const std::string& code) {
+        size_t version = code.find("#version");
+        if (version == std::string::npos || std::atoi(code.c_str() + version + 8) >= 430)
+            return code;
+        std::string adjusted;
+        size_t start = 0;
+        while (start < code.size()) {
+            size_t end = code.find('\n', start);
+            end = end == std::string::npos ? code.size() : end + 1;
+            if (!code.compare(start, 6, "#line ")) {
+                long line = std::atol(code.c_str() + start + 6);
+                size_t rest = code.find_first_not_of("0123456789", start + 6);
+                adjusted += "#line " + std::to_string(line - 1);
+                adjusted.append(code, rest, end - rest);
+            }
+            else {
+                adjusted.append(code, start, end - start);
+            }
+            start = end;
+        }
+        return adjusted;
+    }
+
+    // Defines go right after #version, which has to come first.
+    static std::string injectDefines(const std::string& code,
+        const std::map<std::string, std::string>& defines) {
+        if (defines.empty()) return code;
+        std::string block;
+        for (auto& i : defines) {
+            block += "#define " + i.first + (i.second.empty() ? "" : " " + i.second) + "\n";
+        }
+        size_t version = code.find("#version");
+        size_t end = version == std::string::npos ? version : code.find('\n', version);
+        if (end == std::string::npos) return block + "#line 1 0\n" + code;
+        long line = (long)std::count(code.begin(), code.begin() + end, '\n') + 2;
+        return code.substr(0, end + 1) + block + "#line " + std::to_string(line) +
+            " 0\n" + code.substr(end + 1);
+    }
+
+    // Columns and rows of the types a UniformValue holds, all of 4 byte
+    // scalars; others, such as samplers, are opaque and set as ints.
+    static bool getTypeShape(GLenum type, int& columns, int& rows) {
+        columns = 1;
+        switch (type) {
+        case GL_FLOAT: case GL_INT: case GL_UNSIGNED_INT: rows = 1; return true;
+        case GL_FLOAT_VEC2: rows = 2; return true;
+        case GL_FLOAT_VEC3: rows = 3; return true;
+        case GL_FLOAT_VEC4: rows = 4; return true;
+        case GL_FLOAT_MAT3: columns = rows = 3; return true;
+        case GL_FLOAT_MAT4: columns = rows = 4; return true;
+        default: return false;
+        }
+    }
+
+    // Arrays are reported as their first element.
+    static std::string stripArray(std::string name) {
+        size_t size = name.size();
+        if (size > 3 && !name.compare(size - 3, 3, "[0]")) name.resize(size - 3);
+        return name;
+    }
+
+    // Program 0 sets the uniform of the program in use.
+    static void uploadUniform(GLuint program, GLint location, const UniformValue& value) {
+        const GLfloat* f = static_cast<const GLfloat*>(value.data);
+        const GLint* i = static_cast<const GLint*>(value.data);
+        const GLuint* u = static_cast<const GLuint*>(value.data);
+        GLsizei n = value.count;
+        switch (value.type) {
+        case GL_FLOAT:
+            program ? glProgramUniform1fv(program, location, n, f) : glUniform1fv(location, n, f);
+            break;
+        case GL_FLOAT_VEC2:
+            program ? glProgramUniform2fv(program, location, n, f) : glUniform2fv(location, n, f);
+            break;
+        case GL_FLOAT_VEC3:
+            program ? glProgramUniform3fv(program, location, n, f) : glUniform3fv(location, n, f);
+            break;
+        case GL_FLOAT_VEC4:
+            program ? glProgramUniform4fv(program, location, n, f) : glUniform4fv(location, n, f);
+            break;
+        case GL_INT:
+            program ? glProgramUniform1iv(program, location, n, i) : glUniform1iv(location, n, i);
+            break;
+        case GL_UNSIGNED_INT:
+            program ? glProgramUniform1uiv(program, location, n, u) : glUniform1uiv(location, n, u);
+            break;
+        case GL_FLOAT_MAT3:
+            program ? glProgramUniformMatrix3fv(program, location, n, GL_FALSE, f)
+                : glUniformMatrix3fv(location, n, GL_FALSE, f);
+            break;
+        case GL_FLOAT_MAT4:
+            program ? glProgramUniformMatrix4fv(program, location, n, GL_FALSE, f)
+                : glUniformMatrix4fv(location, n, GL_FALSE, f);
+            break;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////// UniformValue
+
+    UniformValue::UniformValue(const char* name, const GLfloat& value, GLsizei count)
+        : name(name), type(GL_FLOAT), count(count), data(&value) {}
+
+    UniformValue::UniformValue(const char* name, const GLint& value, GLsizei count)
+        : name(name), type(GL_INT), count(count), data(&value) {}
+
+    UniformValue::UniformValue(const char* name, const GLuint& value, GLsizei count)
+        : name(name), type(GL_UNSIGNED_INT), count(count), data(&value) {}
+
+    UniformValue::UniformValue(const char* name, const glm::vec2& value, GLsizei count)
+        : name(name), type(GL_FLOAT_VEC2), count(count), data(&value[0]) {}
+
+    UniformValue::UniformValue(const char* name, const glm::vec3& value, GLsizei count)
+        : name(name), type(GL_FLOAT_VEC3), count(count), data(&value[0]) {}
+
+    UniformValue::UniformValue(const char* name, const glm::vec4& value, GLsizei count)
+        : name(name), type(GL_FLOAT_VEC4), count(count), data(&value[0]) {}
+
+    UniformValue::UniformValue(const char* name, const glm::mat3& value, GLsizei count)
+        : name(name), type(GL_FLOAT_MAT3), count(count), data(&value[0][0]) {}
+
+    UniformValue::UniformValue(const char* name, const glm::mat4& value, GLsizei count)
+        : name(name), type(GL_FLOAT_MAT4), count(count), data(&value[0][0]) {}
+
     ////////////////////////////////////////////////////////////////// ShaderProgram
 
-    const std::string ShaderProgram::read(const std::string& filename) {
-        std::string line, shader_string;
+    ShaderCacheStats ShaderProgram::CacheStats;
+
+    // #include "name" is replaced by that file, found next to the one
+    // including it, once per stage. #line directives keep the compiler's
+    // line numbers right, with files numbered in the order they are read.
+    // Includes are resolved before #ifdef, so they belong outside of one.
+    const std::string ShaderProgram::read(const std::string& filename,
+        std::vector<std::string>& files) {
+        const std::string number = std::to_string(files.size());
+        files.push_back(filename);
+        std::string line, shader_string, included;
         std::ifstream ifile(filename);
+        if (!ifile) std::cerr << "Cannot open shader [" << filename << "]" << std::endl;
+        int line_number = 0;
         while (std::getline(ifile, line)) {
-            shader_string += line + "\n";
+            line_number++;
+            if (!parseInclude(line, included)) {
+                shader_string += line + "\n";
+                continue;
+            }
+            included = filename.substr(0, filename.find_last_of("/\\") + 1) + included;
+            if (std::find(files.begin(), files.end(), included) == files.end()) {
+                shader_string += "#line 1 " + std::to_string(files.size()) + "\n";
+                shader_string += read(included, files);
+            }
+            shader_string += "#line " + std::to_string(line_number + 1) + " " + number + "\n";
         }
         return shader_string;
     }
 
-    const GLuint ShaderProgram::checkCompilation(const GLuint shader_id,
-        const std::string& filename) {
+    // Files are read again each time, so a reload sees changed includes.
+    void ShaderProgram::preprocess() {
+        for (auto& i : Sources) {
+            i.second.files.clear();
+            i.second.code = adjustLines(
+                injectDefines(read(i.second.filename, i.second.files), Defines));
+        }
+    }
+
+    // Logs why it failed; create() gives up, reload() keeps the program.
+    bool ShaderProgram::checkCompilation(const GLuint shader_id,
+        const SourceInfo& source) {
         GLint compiled;
         glGetShaderiv(shader_id, GL_COMPILE_STATUS, &compiled);
         if (compiled == GL_FALSE) {
@@ -33,45 +239,76 @@ namespace mgl {
             glGetShaderiv(shader_id, GL_INFO_LOG_LENGTH, &length);
             GLchar* const log = new char[length];
             glGetShaderInfoLog(shader_id, length, &length, log);
-            std::cerr << "[" << filename << "] " << std::endl << log;
+            std::cerr << "[" << source.filename << "] " << std::endl;
+            for (size_t i = 1; i < source.files.size(); i++) {
+                std::cerr << "  " << i << ": " << source.files[i] << std::endl;
+            }
+            std::cerr << log;
             delete[] log;
-            exit(EXIT_FAILURE);
         }
-        return compiled;
+        return compiled == GL_TRUE;
     }
 
-    void ShaderProgram::checkLinkage() {
+    bool ShaderProgram::checkLinkage(const GLuint program_id) {
         GLint linked;
-        glGetProgramiv(ProgramId, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program_id, GL_LINK_STATUS, &linked);
         if (linked == GL_FALSE) {
             GLint length;
-            glGetProgramiv(ProgramId, GL_INFO_LOG_LENGTH, &length);
+            glGetProgramiv(program_id, GL_INFO_LOG_LENGTH, &length);
             GLchar* const log = new char[length];
-            glGetProgramInfoLog(ProgramId, length, &length, log);
+            glGetProgramInfoLog(program_id, length, &length, log);
             std::cerr << "[LINK] " << std::endl << log << std::endl;
             delete[] log;
-            exit(EXIT_FAILURE);
         }
+        return linked == GL_TRUE;
     }
 
-    ShaderProgram::ShaderProgram() : ProgramId(glCreateProgram()) {}
+    ShaderProgram::ShaderProgram()
+        : ProgramId(glCreateProgram()), Separable(false), PipelineId(0), PendingId(0) {}
 
     ShaderProgram::~ShaderProgram() {
+        discardReload();
         glUseProgram(0);
         glDeleteProgram(ProgramId);
+        if (PipelineId) glDeleteProgramPipelines(1, &PipelineId);
     }
 
+    // Read by create(), once every define is known; compiled there when the
+    // program is not cached.
     void ShaderProgram::addShader(const GLenum shader_type,
         const std::string& filename) {
-        const GLuint shader_id = glCreateShader(shader_type);
-        const std::string scode = read(filename);
-        const GLchar* code = scode.c_str();
-        glShaderSource(shader_id, 1, &code, 0);
-        glCompileShader(shader_id);
-        checkCompilation(shader_id, filename);
-        glAttachShader(ProgramId, shader_id);
+        Sources[shader_type] = { filename, "", {} };
+    }
+
+    // Defined in every stage, with an empty value unless one is given.
+    void ShaderProgram::addDefine(const std::string& name, const std::string& value) {
+        Defines[name] = value;
+    }
+
+    // The program, created separable, runs the given stages [bitmask of
+    // GL_*_SHADER_BIT] of this pipeline; it is not owned. Blocks are bound
+    // by each stage program, so those added here only name them. Plain
+    // uniforms are set through the stage that has the first of them.
+    void ShaderProgram::addStage(const GLbitfield stages, ShaderProgram* program) {
+        Stages.push_back({ stages, program, 0 });
+    }
+
+    // Needed by programs used as a pipeline stage.
+    void ShaderProgram::setSeparable(const bool separable) {
+        Separable = separable;
+    }
 
-        Shaders[shader_type] = { shader_id };
+    void ShaderProgram::compile() {
+        for (auto& i : Sources) {
+            const GLuint shader_id = glCreateShader(i.first);
+            const GLchar* code = i.second.code.c_str();
+            glShaderSource(shader_id, 1, &code, 0);
+            glCompileShader(shader_id);
+            if (!checkCompilation(shader_id, i.second)) exit(EXIT_FAILURE);
+            glAttachShader(ProgramId, shader_id);
+
+            Shaders[i.first] = { shader_id };
+        }
     }
 
     void ShaderProgram::addAttribute(const std::string& name, const GLuint index) {
@@ -100,30 +337,536 @@ namespace mgl {
         return Ubos.find(name) != Ubos.end();
     }
 
+    // Binaries are kept in directory, one file per key; an empty directory
+    // (the default) always compiles.
+    void ShaderProgram::setCacheDirectory(const std::string& directory) {
+        CacheDirectory = directory;
+    }
+
     void ShaderProgram::create() {
-        glLinkProgram(ProgramId);
-        checkLinkage();
-        for (auto& i : Shaders) {
-            glDetachShader(ProgramId, i.second);
-            glDeleteShader(i.second);
+        if (!Stages.empty()) {
+            glGenProgramPipelines(1, &PipelineId);
+            attachStages();
+            return;
         }
+        preprocess();
+        if (Separable) {
+            glProgramParameteri(ProgramId, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        }
+
+        std::string cached;
+        std::uint64_t key = 0;
+        if (!CacheDirectory.empty() && isBinaryCacheSupported()) {
+            key = getCacheKey();
+            cached = getCachePath(key);
+        }
+
+        if (cached.empty() || !loadBinary(cached, key)) {
+            auto start = std::chrono::steady_clock::now();
+            compile();
+            if (!cached.empty()) {
+                glProgramParameteri(ProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            }
+            glLinkProgram(ProgramId);
+            if (!checkLinkage(ProgramId)) exit(EXIT_FAILURE);
+            for (auto& i : Shaders) {
+                glDetachShader(ProgramId, i.second);
+                glDeleteShader(i.second);
+            }
+            if (!cached.empty()) {
+                double seconds = secondsSince(start);
+                CacheStats.misses++;
+                CacheStats.compileSeconds += seconds;
+                saveBinary(cached, key, seconds);
+            }
+        }
+        locateUniforms();
+    }
 
+    // Locations are looked up again for every program that goes live.
+    void ShaderProgram::locateUniforms() {
+        reflect();
+        GLuint active = 0;
         for (auto& i : Uniforms) {
-            i.second.index = glGetUniformLocation(ProgramId, i.first.c_str());
+            const VariableInfo* variable = findVariable(i.first);
+            i.second.index = variable ? variable->location : -1;
             if (i.second.index < 0)
                 std::cerr << "WARNING: Uniform " << i.first << " not found." << std::endl;
+            else if (!active) active = variable->program;
+        }
+        if (PipelineId) {
+            if (active) glActiveShaderProgram(PipelineId, active);
+            return;
         }
         for (auto& i : Ubos) {
-            i.second.index = glGetUniformBlockIndex(ProgramId, i.first.c_str());
-            if (i.second.index < 0)
+            i.second.index = GL_INVALID_INDEX;
+            for (BlockInfo& block : Blocks) {
+                if (block.interface != GL_UNIFORM_BLOCK || block.name != i.first) continue;
+                i.second.index = block.index;
+                block.binding = i.second.binding_point;
+                glUniformBlockBinding(ProgramId, block.index, block.binding);
+            }
+            // a separable stage only has some of its pipeline's blocks
+            if (i.second.index == GL_INVALID_INDEX && !Separable)
                 std::cerr << "WARNING: UBO " << i.first << " not found." << std::endl;
-            glUniformBlockBinding(ProgramId, i.second.index, i.second.binding_point);
         }
     }
 
-    void ShaderProgram::bind() { glUseProgram(ProgramId); }
+    // A pipeline lists what its stages have, each with its own program.
+    void ShaderProgram::reflect() {
+        Variables.clear();
+        Blocks.clear();
+        if (PipelineId) {
+            for (StageInfo& stage : Stages) {
+                GLint base = (GLint)Blocks.size();
+                Blocks.insert(Blocks.end(), stage.program->Blocks.begin(),
+                    stage.program->Blocks.end());
+                for (VariableInfo variable : stage.program->Variables) {
+                    if (variable.block >= 0) variable.block += base;
+                    Variables.push_back(variable);
+                }
+            }
+        }
+        else if (GLEW_VERSION_4_3 || GLEW_ARB_program_interface_query) {
+            reflectResources();
+        }
+        else {
+            reflectActive();
+        }
+        sortReflection();
+    }
+
+    // Uniform blocks come first, so a variable's block index, into its
+    // interface, only needs the storage blocks offset.
+    void ShaderProgram::reflectResources() {
+        const GLenum interfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+        GLint bases[2];
+        for (int i = 0; i < 2; i++) {
+            bases[i] = (GLint)Blocks.size();
+            GLint count = 0;
+            glGetProgramInterfaceiv(ProgramId, interfaces[i], GL_ACTIVE_RESOURCES, &count);
+            const GLenum properties[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+            for (GLint index = 0; index < count; index++) {
+                GLint values[3];
+                glGetProgramResourceiv(ProgramId, interfaces[i], index, 3, properties, 3,
+                    nullptr, values);
+                std::vector<char> name(values[0] + 1);
+                glGetProgramResourceName(ProgramId, interfaces[i], index, (GLsizei)name.size(),
+                    nullptr, name.data());
+                Blocks.push_back({ name.data(), interfaces[i], (GLuint)index, values[1],
+                    values[2] });
+            }
+        }
 
-    void ShaderProgram::unbind() { glUseProgram(0); }
+        // buffer variables have no location, so it is asked for last
+        const GLenum variables[] = { GL_UNIFORM, GL_BUFFER_VARIABLE };
+        const GLenum properties[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX,
+            GL_OFFSET, GL_ARRAY_STRIDE, GL_MATRIX_STRIDE, GL_LOCATION };
+        for (int i = 0; i < 2; i++) {
+            GLint count = 0;
+            glGetProgramInterfaceiv(ProgramId, variables[i], GL_ACTIVE_RESOURCES, &count);
+            GLsizei asked = variables[i] == GL_UNIFORM ? 8 : 7;
+            for (GLint index = 0; index < count; index++) {
+                GLint values[8] = { 0, 0, 0, 0, 0, 0, 0, -1 };
+                glGetProgramResourceiv(ProgramId, variables[i], index, asked, properties, 8,
+                    nullptr, values);
+                std::vector<char> name(values[0] + 1);
+                glGetProgramResourceName(ProgramId, variables[i], index, (GLsizei)name.size(),
+                    nullptr, name.data());
+                GLint block = values[3] < 0 ? -1 : values[3] + bases[i];
+                Variables.push_back({ stripArray(name.data()), (GLenum)values[1], values[2],
+                    values[7], block, values[4], values[5], values[6], ProgramId });
+            }
+        }
+    }
+
+    // Before GL 4.3 there are only uniforms and uniform blocks to list.
+    void ShaderProgram::reflectActive() {
+        GLint count = 0, length = 0;
+        glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for (GLint index = 0; index < count; index++) {
+            GLint binding, size;
+            glGetActiveUniformBlockiv(ProgramId, index, GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+            glGetActiveUniformBlockiv(ProgramId, index, GL_UNIFORM_BLOCK_BINDING, &binding);
+            glGetActiveUniformBlockiv(ProgramId, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            std::vector<char> name(length + 1);
+            glGetActiveUniformBlockName(ProgramId, index, (GLsizei)name.size(), nullptr,
+                name.data());
+            Blocks.push_back({ name.data(), GL_UNIFORM_BLOCK, (GLuint)index, binding, size });
+        }
+
+        glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+        std::vector<char> name(length + 1);
+        for (GLuint index = 0; index < (GLuint)count; index++) {
+            GLint size, block, offset, arrayStride, matrixStride;
+            GLenum type;
+            glGetActiveUniform(ProgramId, index, (GLsizei)name.size(), nullptr, &size, &type,
+                name.data());
+            glGetActiveUniformsiv(ProgramId, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+            glGetActiveUniformsiv(ProgramId, 1, &index, GL_UNIFORM_OFFSET, &offset);
+            glGetActiveUniformsiv(ProgramId, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &arrayStride);
+            glGetActiveUniformsiv(ProgramId, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &matrixStride);
+            GLint location = block < 0 ? glGetUniformLocation(ProgramId, name.data()) : -1;
+            Variables.push_back({ stripArray(name.data()), type, size, location, block,
+                offset, arrayStride, matrixStride, ProgramId });
+        }
+    }
+
+    void ShaderProgram::sortReflection() {
+        std::vector<size_t> order(Blocks.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            return Blocks[a].name < Blocks[b].name;
+        });
+        std::vector<GLint> remap(Blocks.size());
+        std::vector<BlockInfo> sorted;
+        for (size_t i = 0; i < order.size(); i++) {
+            remap[order[i]] = (GLint)i;
+            sorted.push_back(Blocks[order[i]]);
+        }
+        Blocks.swap(sorted);
+        for (VariableInfo& variable : Variables) {
+            if (variable.block >= 0) variable.block = remap[variable.block];
+        }
+        std::stable_sort(Variables.begin(), Variables.end(),
+            [](const VariableInfo& a, const VariableInfo& b) {
+                return a.name != b.name ? a.name < b.name : a.block < b.block;
+            });
+    }
+
+    const std::vector<ShaderProgram::VariableInfo>& ShaderProgram::getVariables() {
+        return Variables;
+    }
+
+    const std::vector<ShaderProgram::BlockInfo>& ShaderProgram::getBlocks() {
+        return Blocks;
+    }
+
+    // Plain uniforms are in block -1; block members under the names the
+    // GL gives them.
+    const ShaderProgram::VariableInfo* ShaderProgram::findVariable(
+        const std::string& name, GLint block) {
+        auto found = std::lower_bound(Variables.begin(), Variables.end(), name,
+            [block](const VariableInfo& variable, const std::string& name) {
+                return variable.name != name ? variable.name < name : variable.block < block;
+            });
+        if (found == Variables.end() || found->name != name || found->block != block)
+            return nullptr;
+        return &*found;
+    }
+
+    const ShaderProgram::BlockInfo* ShaderProgram::findBlock(const std::string& name) {
+        auto found = std::lower_bound(Blocks.begin(), Blocks.end(), name,
+            [](const BlockInfo& block, const std::string& name) { return block.name < name; });
+        if (found == Blocks.end() || found->name != name) return nullptr;
+        return &*found;
+    }
+
+    // Uniforms of the bound program, or of a pipeline's stages, set in one
+    // go. Each value is checked against the reflected type and array size.
+    // Names the program does not have are skipped but make the call false,
+    // as the compiler drops unused uniforms and a typo looks the same;
+    // reflected ones without a location are skipped silently. False if any
+    // value was rejected or missing.
+    bool ShaderProgram::setUniforms(std::initializer_list<UniformValue> values) {
+        bool valid = true;
+        int columns, rows;
+        for (const UniformValue& value : values) {
+            const VariableInfo* variable = findVariable(value.name);
+            if (!variable) {
+#ifdef DEBUG
+                std::cerr << "WARNING: Uniform " << value.name << " not found." << std::endl;
+#endif
+                valid = false;
+                continue;
+            }
+            if (variable->location < 0) continue;
+            bool opaque = !getTypeShape(variable->type, columns, rows);
+            if ((value.type != variable->type && !(opaque && value.type == GL_INT)) ||
+                value.count > variable->arraySize) {
+                std::cerr << "WARNING: Uniform " << value.name << " set with the wrong type."
+                    << std::endl;
+                valid = false;
+                continue;
+            }
+            uploadUniform(PipelineId ? variable->program : 0, variable->location, value);
+        }
+        return valid;
+    }
+
+    // Members of the named block written at their reflected offsets into
+    // data, the size bytes where the block's contents are built, such as a
+    // ring buffer allocation. Columns and array elements are spaced by the
+    // block's strides, so a mat3 gets its std140 padding. Checked like
+    // setUniforms(); false as well if the block is missing or does not fit
+    // in size.
+    bool ShaderProgram::writeBlock(const std::string& name, void* data, size_t size,
+        std::initializer_list<UniformValue> values) {
+        const BlockInfo* block = findBlock(name);
+        if (!block) {
+#ifdef DEBUG
+            std::cerr << "WARNING: Block " << name << " not found." << std::endl;
+#endif
+            return false;
+        }
+        if ((size_t)block->dataSize > size) {
+            std::cerr << "WARNING: Block " << name << " needs " << block->dataSize
+                << " bytes." << std::endl;
+            return false;
+        }
+        GLint index = (GLint)(block - Blocks.data());
+        bool valid = true;
+        int columns, rows;
+        for (const UniformValue& value : values) {
+            const VariableInfo* variable = findVariable(value.name, index);
+            if (!variable) {
+#ifdef DEBUG
+                std::cerr << "WARNING: Member " << value.name << " of " << name
+                    << " not found." << std::endl;
+#endif
+                valid = false;
+                continue;
+            }
+            if (value.type != variable->type || !getTypeShape(value.type, columns, rows) ||
+                value.count > std::max(variable->arraySize, 1)) {
+                std::cerr << "WARNING: Member " << value.name << " of " << name
+                    << " written with the wrong type." << std::endl;
+                valid = false;
+                continue;
+            }
+            const char* source = static_cast<const char*>(value.data);
+            char* target = static_cast<char*>(data) + variable->offset;
+            size_t vector = rows * sizeof(GLfloat);
+            for (GLsizei element = 0; element < value.count; element++) {
+                for (int column = 0; column < columns; column++) {
+                    std::memcpy(target + element * variable->arrayStride +
+                        column * variable->matrixStride, source, vector);
+                    source += vector;
+                }
+            }
+        }
+        return valid;
+    }
+
+    // The files are read again; until pollReload() the live program keeps
+    // drawing. Drivers with parallel shader compile work on the new one in
+    // the background, others when pollReload() first asks for the result.
+    void ShaderProgram::reload() {
+        discardReload();
+        preprocess();
+        PendingId = glCreateProgram();
+        if (Separable) {
+            glProgramParameteri(PendingId, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        }
+        for (auto& i : Attributes) {
+            glBindAttribLocation(PendingId, i.second.index, i.first.c_str());
+        }
+        for (auto& i : Sources) {
+            const GLuint shader_id = glCreateShader(i.first);
+            const GLchar* code = i.second.code.c_str();
+            glShaderSource(shader_id, 1, &code, 0);
+            glCompileShader(shader_id);
+            glAttachShader(PendingId, shader_id);
+            PendingShaders[i.first] = shader_id;
+        }
+        if (!CacheDirectory.empty()) {
+            glProgramParameteri(PendingId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(PendingId);
+    }
+
+    // False while the driver is still busy; otherwise the new program went
+    // live, and into the cache, or failed and was dropped. Call between
+    // frames on the context thread, so no draw sees half a swap.
+    bool ShaderProgram::pollReload() {
+        if (!PendingId) return true;
+        if (GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile) {
+            GLint completed;
+            glGetProgramiv(PendingId, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed == GL_FALSE) return false;
+        }
+
+        bool compiled = true;
+        for (auto& i : PendingShaders) {
+            compiled = checkCompilation(i.second, Sources[i.first]) && compiled;
+        }
+        if (!compiled || !checkLinkage(PendingId)) {
+            std::cerr << "Reload failed, the previous program stays." << std::endl;
+            discardReload();
+            return true;
+        }
+
+        for (auto& i : PendingShaders) {
+            glDetachShader(PendingId, i.second);
+            glDeleteShader(i.second);
+        }
+        PendingShaders.clear();
+        glDeleteProgram(ProgramId);
+        ProgramId = PendingId;
+        PendingId = 0;
+        locateUniforms();
+        if (!CacheDirectory.empty() && isBinaryCacheSupported()) {
+            std::uint64_t key = getCacheKey();
+            saveBinary(getCachePath(key), key, 0.0);
+        }
+        return true;
+    }
+
+    void ShaderProgram::discardReload() {
+        for (auto& i : PendingShaders) {
+            glDeleteShader(i.second);
+        }
+        PendingShaders.clear();
+        if (PendingId) glDeleteProgram(PendingId);
+        PendingId = 0;
+    }
+
+    // Included files too, once create() has read them.
+    std::vector<std::string> ShaderProgram::getFilenames() {
+        std::vector<std::string> filenames;
+        for (auto& i : Sources) {
+            if (i.second.files.empty()) filenames.push_back(i.second.filename);
+            for (const std::string& filename : i.second.files) {
+                if (std::find(filenames.begin(), filenames.end(), filename) == filenames.end())
+                    filenames.push_back(filename);
+            }
+        }
+        return filenames;
+    }
+
+    // Everything that changes the linked program: the sources in stage
+    // order, with their includes and defines, the attribute locations bound
+    // before linking, whether it is separable and the driver, whose
+    // binaries are only good for itself.
+    std::uint64_t ShaderProgram::getCacheKey() {
+        std::uint64_t key = hashBytes(&PROGRAM_BINARY_VERSION, sizeof(std::uint32_t));
+        key = hashBytes(&Separable, sizeof(Separable), key);
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            const char* value = reinterpret_cast<const char*>(glGetString(name));
+            if (value) key = hashBytes(value, std::strlen(value), key);
+        }
+        for (auto& i : Sources) {
+            key = hashBytes(&i.first, sizeof(i.first), key);
+            key = hashBytes(i.second.code.data(), i.second.code.size(), key);
+        }
+        for (auto& i : Attributes) {
+            key = hashBytes(i.first.data(), i.first.size() + 1, key);
+            key = hashBytes(&i.second.index, sizeof(i.second.index), key);
+        }
+        return key;
+    }
+
+    std::string ShaderProgram::getCachePath(std::uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.program", (unsigned long long)key);
+        return CacheDirectory + "/" + name;
+    }
+
+    // A binary the driver rejects, usually after it was updated, is stale.
+    bool ShaderProgram::loadBinary(const std::string& path, std::uint64_t key) {
+        auto start = std::chrono::steady_clock::now();
+        MappedFile file;
+        if (!file.open(path)) return false;
+        ProgramBinaryHeader header;
+        if (file.size() < sizeof(header)) {
+            CacheStats.stale++;
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "MGLP", 4) ||
+            header.version != PROGRAM_BINARY_VERSION || header.key != key ||
+            file.size() != sizeof(header) + header.length) {
+            CacheStats.stale++;
+            return false;
+        }
+
+        glProgramBinary(ProgramId, header.format, file.data() + sizeof(header),
+            (GLsizei)header.length);
+        GLint linked;
+        glGetProgramiv(ProgramId, GL_LINK_STATUS, &linked);
+        if (linked == GL_FALSE) {
+            CacheStats.stale++;
+            return false;
+        }
+        CacheStats.hits++;
+        CacheStats.savedSeconds += std::max(header.compileSeconds - secondsSince(start), 0.0);
+        return true;
+    }
+
+    void ShaderProgram::saveBinary(const std::string& path, std::uint64_t key,
+        double seconds) {
+        GLint length = 0;
+        glGetProgramiv(ProgramId, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        if (!createDirectory(CacheDirectory)) {
+            std::cerr << "Cannot create shader cache [" << CacheDirectory << "]"
+                << std::endl;
+            return;
+        }
+        std::vector<char> binary(length);
+        GLenum format;
+        glGetProgramBinary(ProgramId, length, &length, &format, binary.data());
+
+        ProgramBinaryHeader header;
+        std::memcpy(header.magic, "MGLP", 4);
+        header.version = PROGRAM_BINARY_VERSION;
+        header.key = key;
+        header.format = format;
+        header.length = (std::uint32_t)length;
+        header.compileSeconds = seconds;
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(binary.data(), length);
+            if (!file) {
+                std::cerr << "Cannot write program binary [" << path << "]" << std::endl;
+                return;
+            }
+        }
+        std::remove(path.c_str());
+        std::rename(temporary.c_str(), path.c_str());
+    }
+
+    ShaderCacheStats ShaderProgram::getCacheStats() { return CacheStats; }
+
+    void ShaderProgram::printCacheStats() {
+        std::cout << "Shader cache [" << CacheStats.hits << " hit(s), "
+            << CacheStats.misses << " miss(es), " << CacheStats.stale
+            << " stale, " << 1000.0 * CacheStats.compileSeconds
+            << " ms compiling, " << 1000.0 * CacheStats.savedSeconds
+            << " ms saved]" << std::endl;
+    }
+
+    // A pipeline is only used while no program is.
+    void ShaderProgram::bind() {
+        if (!PipelineId) {
+            glUseProgram(ProgramId);
+            return;
+        }
+        attachStages();
+        glUseProgram(0);
+        glBindProgramPipeline(PipelineId);
+    }
+
+    void ShaderProgram::unbind() {
+        glUseProgram(0);
+        if (PipelineId) glBindProgramPipeline(0);
+    }
+
+    // Again whenever a stage was reloaded, since it is then a new program.
+    void ShaderProgram::attachStages() {
+        bool attached = false;
+        for (StageInfo& stage : Stages) {
+            if (stage.attached == stage.program->ProgramId) continue;
+            glUseProgramStages(PipelineId, stage.stages, stage.program->ProgramId);
+            stage.attached = stage.program->ProgramId;
+            attached = true;
+        }
+        if (attached) locateUniforms();
+    }
 
     ////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
\ No newline at end of file
@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Shader Variants Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglShaderVariants.hpp"
+
+#include <cstdio>
+
+#include "./mglConventions.hpp"
+#include "./mglManager.hpp"
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    // Indexed by feature bit.
+    static const char* const FEATURE_DEFINES[] = {
+        NORMALS_DEFINE, TEXCOORDS_DEFINE, TANGENTS_DEFINE, COMPRESSED_DEFINE,
+        VERTEX_COLORS_DEFINE, INSTANCING_DEFINE, SKINNING_DEFINE
+    };
+
+    static bool isSeparableSupported() {
+        return GLEW_VERSION_4_1 || GLEW_ARB_separate_shader_objects;
+    }
+
+    static GLbitfield getStageBit(GLenum shader_type) {
+        switch (shader_type) {
+        case GL_VERTEX_SHADER: return GL_VERTEX_SHADER_BIT;
+        case GL_TESS_CONTROL_SHADER: return GL_TESS_CONTROL_SHADER_BIT;
+        case GL_TESS_EVALUATION_SHADER: return GL_TESS_EVALUATION_SHADER_BIT;
+        case GL_GEOMETRY_SHADER: return GL_GEOMETRY_SHADER_BIT;
+        case GL_FRAGMENT_SHADER: return GL_FRAGMENT_SHADER_BIT;
+        case GL_COMPUTE_SHADER: return GL_COMPUTE_SHADER_BIT;
+        default: return 0;
+        }
+    }
+
+    static const char* getStageName(GLenum shader_type) {
+        switch (shader_type) {
+        case GL_VERTEX_SHADER: return "vs";
+        case GL_TESS_CONTROL_SHADER: return "tcs";
+        case GL_TESS_EVALUATION_SHADER: return "tes";
+        case GL_GEOMETRY_SHADER: return "gs";
+        case GL_FRAGMENT_SHADER: return "fs";
+        case GL_COMPUTE_SHADER: return "cs";
+        default: return "stage";
+        }
+    }
+
+    //////////////////////////////////////////////////////////////// SHADER VARIANTS
+
+    ShaderVariants::ShaderVariants(const std::string& name)
+        : Name(name), Separable(false) {}
+
+    const std::string& ShaderVariants::getName() { return Name; }
+
+    // features are the ones the stage's code tests for.
+    void ShaderVariants::addShader(const GLenum shader_type,
+        const std::string& filename, const unsigned int features) {
+        Stages.push_back({ shader_type, filename, features });
+    }
+
+    void ShaderVariants::addAttribute(const std::string& name, const GLuint index) {
+        Attributes[name] = index;
+    }
+
+    void ShaderVariants::addUniform(const std::string& name) {
+        Uniforms.push_back(name);
+    }
+
+    void ShaderVariants::addUniformBlock(const std::string& name,
+        const GLuint binding_point) {
+        Ubos[name] = binding_point;
+    }
+
+    // Defined in every variant, besides its features.
+    void ShaderVariants::addDefine(const std::string& name, const std::string& value) {
+        Defines[name] = value;
+    }
+
+    void ShaderVariants::setCacheDirectory(const std::string& directory) {
+        CacheDirectory = directory;
+    }
+
+    void ShaderVariants::setSeparable(const bool separable) {
+        Separable = separable;
+    }
+
+    // Features no stage tests for do not make a variant of their own.
+    ShaderProgram* ShaderVariants::get(unsigned int features) {
+        features &= getMask();
+        auto found = Variants.find(features);
+        if (found != Variants.end()) return found->second;
+
+        ShaderProgram* program = new ShaderProgram();
+        if (Separable && isSeparableSupported()) {
+            for (const StageInfo& stage : Stages) {
+                program->addStage(getStageBit(stage.type), getStage(stage, features));
+            }
+            for (const std::string& uniform : Uniforms) {
+                program->addUniform(uniform);
+            }
+            for (auto& i : Ubos) {
+                program->addUniformBlock(i.first, i.second);
+            }
+        }
+        else {
+            configure(program, features);
+            for (const StageInfo& stage : Stages) {
+                program->addShader(stage.type, stage.filename);
+            }
+            for (const std::string& uniform : Uniforms) {
+                program->addUniform(uniform);
+            }
+        }
+        program->create();
+
+        Variants[features] = program;
+        ShaderManager::getInstance().add(getKey(Name, features), program);
+        return program;
+    }
+
+    size_t ShaderVariants::getCount() { return Variants.size(); }
+
+    unsigned int ShaderVariants::getMask() {
+        unsigned int mask = 0;
+        for (const StageInfo& stage : Stages) {
+            mask |= stage.features;
+        }
+        return mask;
+    }
+
+    ShaderProgram* ShaderVariants::getStage(const StageInfo& stage,
+        unsigned int features) {
+        features &= stage.features;
+        auto key = std::make_pair(stage.type, features);
+        auto found = StagePrograms.find(key);
+        if (found != StagePrograms.end()) return found->second;
+
+        ShaderProgram* program = new ShaderProgram();
+        program->setSeparable(true);
+        configure(program, features);
+        program->addShader(stage.type, stage.filename);
+        program->create();
+
+        StagePrograms[key] = program;
+        ShaderManager::getInstance().add(
+            getKey(Name + ":" + getStageName(stage.type), features), program);
+        return program;
+    }
+
+    // Plain uniforms are left to the caller, as a pipeline finds them in
+    // its stages.
+    void ShaderVariants::configure(ShaderProgram* program, unsigned int features) {
+        program->setCacheDirectory(CacheDirectory);
+        for (auto& i : Defines) {
+            program->addDefine(i.first, i.second);
+        }
+        for (unsigned int i = 0; (ALL_FEATURES >> i) & 1; i++) {
+            if (features & (1u << i)) program->addDefine(FEATURE_DEFINES[i]);
+        }
+        for (auto& i : Attributes) {
+            program->addAttribute(i.first, i.second);
+        }
+        for (auto& i : Ubos) {
+            program->addUniformBlock(i.first, i.second);
+        }
+    }
+
+    std::string ShaderVariants::getKey(const std::string& prefix,
+        unsigned int features) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ":%02x", features);
+        return prefix + suffix;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
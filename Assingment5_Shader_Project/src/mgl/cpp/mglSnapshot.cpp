@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Scene Snapshot Classes
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglSnapshot.hpp"
+
+#include <iostream>
+
+#include "./mglCamera.hpp"
+#include "./mglConventions.hpp"
+#include "./mglManager.hpp"
+#include "./mglMesh.hpp"
+#include "./mglProfiler.hpp"
+#include "./mglShader.hpp"
+
+namespace mgl {
+
+    /////////////////////////////////////////////////////////////////////// SNAPSHOT
+
+    // std140 layouts of the Frame and Object blocks
+    struct FrameBlock {
+        glm::vec4 light;
+        glm::vec4 eye;
+    };
+
+    struct ObjectBlock {
+        glm::mat4 model;
+        glm::vec4 normal[3];
+        glm::vec4 color;
+    };
+
+    void drawItem(const DrawItem& item, ShaderProgram* shader, FrameConstants& frame,
+        GLint stencil) {
+        glStencilFunc(GL_ALWAYS, stencil, 0xFF);
+
+        shader->bind();
+        RingBuffer& ring = RingBuffer::getInstance();
+
+        // compressed meshes store positions inside their bounding box
+        glm::mat4 model = item.mesh->hasCompressedVertices()
+            ? item.world * item.mesh->getPositionMatrix() : item.world;
+
+        if (shader->isUniformBlock(mgl::OBJECT_BLOCK)) {
+            RingBuffer::Allocation block = ring.allocate(sizeof(ObjectBlock));
+            ObjectBlock* object = static_cast<ObjectBlock*>(block.data);
+            object->model = model;
+            for (int i = 0; i < 3; i++) {
+                object->normal[i] = glm::vec4(item.normal[i], 0.0f);
+            }
+            object->color = glm::vec4(item.color, 1.0f);
+            ring.bind(shader->Ubos[mgl::OBJECT_BLOCK].binding_point, block);
+        }
+        else {
+            shader->setUniforms({
+                { mgl::MODEL_MATRIX, model },
+                { mgl::NORMAL_MATRIX, item.normal },
+                { mgl::COLOR, item.color } });
+        }
+
+        bindFrameConstants(shader, frame);
+
+        if (item.mesh->hasMeshlets()) {
+            // meshlet bounds are in the space of the original positions
+            glm::vec3 eye = glm::vec3(glm::inverse(item.world) * glm::vec4(frame.eye, 1.0f));
+            item.mesh->drawMeshlets(frame.viewProjection * item.world, eye);
+        }
+        else {
+            item.mesh->draw();
+        }
+
+        shader->unbind();
+    }
+
+    void bindFrameConstants(ShaderProgram* shader, FrameConstants& frame) {
+        if (shader->isUniformBlock(mgl::FRAME_BLOCK)) {
+            RingBuffer& ring = RingBuffer::getInstance();
+            if (!frame.block.data) {
+                frame.block = ring.allocate(sizeof(FrameBlock));
+                FrameBlock* constants = static_cast<FrameBlock*>(frame.block.data);
+                constants->light = glm::vec4(frame.light, 1.0f);
+                constants->eye = glm::vec4(frame.eye, 1.0f);
+            }
+            ring.bind(shader->Ubos[mgl::FRAME_BLOCK].binding_point, frame.block);
+        }
+        else {
+            shader->setUniforms({
+                { mgl::LIGHT_POSITION, frame.light },
+                { mgl::EYE_POSITION, frame.eye } });
+        }
+    }
+
+    ////////////////////////////////////////////////////////////// SNAPSHOT RENDERER
+
+    SnapshotRenderer::SnapshotRenderer() : last(nullptr) {}
+
+    // Shaders are looked up here, on the render thread, which builds the
+    // variants first used; runs of items sharing one look it up once.
+    void SnapshotRenderer::draw(const SceneSnapshot& snapshot) {
+        MGL_PROFILE_SCOPE("SnapshotRenderer::draw")
+        MGL_PROFILE_GPU_SCOPE("SnapshotRenderer::draw")
+        // the scenegraph cameras never touch GL in a threaded app
+        uploadCamera(snapshot.bindingPoint, snapshot.view, snapshot.projection);
+
+        FrameConstants frame;
+        frame.light = snapshot.light;
+        frame.eye = snapshot.eye;
+        frame.viewProjection = snapshot.projection * snapshot.view;
+
+        glEnable(GL_STENCIL_TEST);
+        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        ShaderProgram* shader = nullptr;
+        const DrawItem* previous = nullptr;
+        for (size_t i = 0; i < snapshot.items.size(); i++) {
+            const DrawItem& item = snapshot.items[i];
+            if (!previous || item.shaderFeatures != previous->shaderFeatures ||
+                item.shaderKey != previous->shaderKey) {
+                shader = ShaderManager::getInstance().get(item.shaderKey,
+                    item.shaderFeatures);
+                previous = &item;
+            }
+            if (!item.mesh || !shader) continue;
+            drawItem(item, shader, frame, i + 1);
+        }
+        glDisable(GL_STENCIL_TEST);
+        last = &snapshot;
+    }
+
+    // Stencil values are positions in the last snapshot drawn, which the
+    // render thread still owns, so they map back to the right node even if
+    // the scenegraph has changed since.
+    void SnapshotRenderer::pick(int x, int y) {
+        GLuint nodeID = 0;
+        glReadPixels(x, y, 1, 1, GL_STENCIL_INDEX, GL_UNSIGNED_INT, &nodeID);
+        NodeHandle handle;
+        if (last && nodeID > 0 && nodeID <= last->items.size()) {
+            handle = last->items[nodeID - 1].handle;
+        }
+        if (!picked.push(handle)) {
+            std::cerr << "pick dropped: too many pending picks" << std::endl;
+        }
+    }
+
+    // Main thread only.
+    bool SnapshotRenderer::pollPick(NodeHandle& handle) {
+        return picked.pop(handle);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
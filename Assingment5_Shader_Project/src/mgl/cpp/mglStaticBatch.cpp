@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Static Batch Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglStaticBatch.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include <glm/gtx/transform.hpp>
+
+#include "./mglGeometryPool.hpp"
+#include "./mglMesh.hpp"
+#include "./mglProfiler.hpp"
+#include "./mglShader.hpp"
+#include "./mglSnapshot.hpp"
+#include "./mglVertexFormat.hpp"
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    // Baked vertices, already in world space
+    typedef VertexFormat<
+        FloatAttribute<Mesh::POSITION, glm::vec3, &VertexSource::positions>,
+        FloatAttribute<Mesh::NORMAL, glm::vec3, &VertexSource::normals>,
+        FloatAttribute<Mesh::COLOR, glm::vec3, &VertexSource::colors>> StaticFormat;
+
+    /////////////////////////////////////////////////////////////////// STATIC BATCH
+
+    StaticBatch::StaticBatch(ShaderProgram* shader, float chunkSize)
+        : Shader(shader), ChunkSize(chunkSize) {}
+
+    StaticBatch::~StaticBatch() {
+        clear();
+    }
+
+    // Called for every change of a node; nodes that are not static only
+    // leave the chunk they were in.
+    void StaticBatch::place(SceneNode* node) {
+        NodeHandle handle = node->getHandle();
+        remove(handle);
+        if (!node->isStatic()) return;
+
+        glm::vec3 cell = glm::floor(node->getTranslation() / ChunkSize);
+        ChunkKey key((int)cell.x, (int)cell.y, (int)cell.z);
+        Chunks[key].nodes.push_back(handle);
+        Placement[handle.slot] = key;
+        Dirty.insert(key);
+    }
+
+    void StaticBatch::remove(NodeHandle handle) {
+        auto placed = Placement.find(handle.slot);
+        if (placed == Placement.end()) return;
+
+        std::vector<NodeHandle>& nodes = Chunks[placed->second].nodes;
+        nodes.erase(std::find_if(nodes.begin(), nodes.end(),
+            [&handle](const NodeHandle& h) { return h.slot == handle.slot; }));
+        Dirty.insert(placed->second);
+        Placement.erase(placed);
+    }
+
+    void StaticBatch::clear() {
+        for (auto& chunk : Chunks) {
+            if (chunk.second.geometry) {
+                GeometryPool::getInstance().free(chunk.second.geometry);
+            }
+        }
+        Chunks.clear();
+        Placement.clear();
+        Dirty.clear();
+    }
+
+    void StaticBatch::rebuild(Scenegraph* scenegraph) {
+        if (Dirty.empty()) return;
+        MGL_PROFILE_SCOPE("StaticBatch::rebuild")
+        for (const ChunkKey& key : Dirty) {
+            Chunk& chunk = Chunks[key];
+            bake(scenegraph, chunk);
+            if (chunk.nodes.empty()) {
+                Chunks.erase(key);
+            }
+        }
+        Dirty.clear();
+    }
+
+    // Nodes whose mesh is missing or did not keep its arrays are left out
+    // until they are placed again.
+    void StaticBatch::bake(Scenegraph* scenegraph, Chunk& chunk) {
+        std::vector<glm::vec3> positions, normals, colors;
+        std::vector<unsigned int> indices;
+        for (const NodeHandle& handle : chunk.nodes) {
+            SceneNode* node = scenegraph->getNode(handle);
+            Mesh* mesh = node ? node->getMesh() : nullptr;
+            if (!mesh) continue;
+            glm::mat4 world = glm::translate(node->getTranslation()) *
+                glm::mat4_cast(node->getRotation()) * glm::scale(node->getScaling());
+            if (!mesh->appendTransformed(world, positions, normals, indices)) {
+                std::cerr << "WARNING: static node left out, its mesh did not keep "
+                    "its vertices." << std::endl;
+                continue;
+            }
+            colors.resize(positions.size(), node->getColor());
+        }
+
+        GeometryPool& pool = GeometryPool::getInstance();
+        if (chunk.geometry) {
+            pool.free(chunk.geometry);
+            chunk.geometry = nullptr;
+        }
+        if (indices.empty()) return;
+
+        VertexSource source;
+        source.positions = positions.data();
+        source.normals = normals.data();
+        source.colors = colors.data();
+        std::vector<unsigned char> vertices;
+        packVertices<StaticFormat>(source, positions.size(), vertices);
+        chunk.geometry = pool.allocate(StaticFormat::layout(), positions.size(),
+            indices.size());
+        pool.upload(chunk.geometry, vertices.data(), indices.data());
+
+        glm::vec3 min = positions[0], max = positions[0];
+        for (const glm::vec3& p : positions) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+        chunk.center = 0.5f * (min + max);
+        chunk.radius = glm::length(max - chunk.center);
+    }
+
+    void StaticBatch::draw(const glm::mat4& viewProjection, FrameConstants& frame) {
+        if (Chunks.empty()) return;
+        MGL_PROFILE_SCOPE("StaticBatch::draw")
+        // frustum planes from the rows of the view-projection matrix
+        glm::mat4 m = glm::transpose(viewProjection);
+        glm::vec4 planes[6] = {
+            m[3] + m[0], m[3] - m[0],
+            m[3] + m[1], m[3] - m[1],
+            m[3] + m[2], m[3] - m[2]
+        };
+        for (auto& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        glStencilFunc(GL_ALWAYS, 0, 0xFF);
+        Shader->bind();
+        bindFrameConstants(Shader, frame);
+        GeometryPool& pool = GeometryPool::getInstance();
+        for (auto& entry : Chunks) {
+            const Chunk& chunk = entry.second;
+            if (!chunk.geometry) continue;
+            bool inside = true;
+            for (auto& plane : planes) {
+                if (glm::dot(glm::vec3(plane), chunk.center) + plane.w < -chunk.radius) {
+                    inside = false;
+                    break;
+                }
+            }
+            if (!inside) continue;
+
+            pool.bind(chunk.geometry);
+            glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)chunk.geometry->indexCount,
+                GL_UNSIGNED_INT,
+                reinterpret_cast<void*>(sizeof(unsigned int) * chunk.geometry->firstIndex),
+                (GLint)chunk.geometry->firstVertex);
+        }
+        Shader->unbind();
+    }
+
+    size_t StaticBatch::getChunkCount() { return Chunks.size(); }
+
+    size_t StaticBatch::getNodeCount() { return Placement.size(); }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
@@ -0,0 +1,371 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Batched Transform Composition
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "./mglTransform.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MGL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MGL_TARGET(isa)
+#else
+#define MGL_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////////// SIMD PATH
+
+#ifdef MGL_X86
+#ifdef _MSC_VER
+    static bool cpuHasSSE4() {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+    }
+
+    static bool cpuHasAVX2() {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        // OS must save the YMM registers (OSXSAVE + XCR0 bits 1 and 2)
+        if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+#else
+    static bool cpuHasSSE4() { return __builtin_cpu_supports("sse4.1"); }
+
+    static bool cpuHasAVX2() { return __builtin_cpu_supports("avx2"); }
+#endif
+#endif
+
+    static SimdPath detectSimdPath() {
+#ifdef MGL_X86
+        if (cpuHasAVX2()) return SimdPath::AVX2;
+        if (cpuHasSSE4()) return SimdPath::SSE4;
+#endif
+        return SimdPath::SCALAR;
+    }
+
+    // SSE4 by default: the AVX2 kernel is only ahead while the batch stays
+    // in cache and ties once it streams from memory [perf_compose_transforms].
+    static SimdPath& currentSimdPath() {
+        static SimdPath path =
+            detectSimdPath() < SimdPath::SSE4 ? detectSimdPath() : SimdPath::SSE4;
+        return path;
+    }
+
+    SimdPath getSimdPath() { return currentSimdPath(); }
+
+    void setSimdPath(SimdPath path) {
+        // never select a path the cpu cannot run
+        currentSimdPath() = path < detectSimdPath() ? path : detectSimdPath();
+    }
+
+    const char* getSimdPathName(SimdPath path) {
+        switch (path) {
+        case SimdPath::AVX2:
+            return "AVX2";
+        case SimdPath::SSE4:
+            return "SSE4";
+        default:
+            return "scalar";
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////// TRANSFORMS
+
+    void composeTransforms(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals) {
+        switch (getSimdPath()) {
+        case SimdPath::AVX2:
+            composeTransformsAVX2(count, translations, rotations, scales, worlds,
+                normals);
+            break;
+        case SimdPath::SSE4:
+            composeTransformsSSE4(count, translations, rotations, scales, worlds,
+                normals);
+            break;
+        default:
+            composeTransformsScalar(count, translations, rotations, scales, worlds,
+                normals);
+            break;
+        }
+    }
+
+    // Rotation columns follow glm::mat3_cast term by term, so that the world
+    // matrices match translate(t) * toMat4(q) * scale(s) exactly.
+    static void composeTransform(const glm::vec3& t, const glm::quat& q,
+        const glm::vec3& s, glm::mat4& world, glm::mat3* normal) {
+        const float qxx = q.x * q.x, qyy = q.y * q.y, qzz = q.z * q.z;
+        const float qxz = q.x * q.z, qxy = q.x * q.y, qyz = q.y * q.z;
+        const float qwx = q.w * q.x, qwy = q.w * q.y, qwz = q.w * q.z;
+
+        const glm::vec3 r0(1.0f - 2.0f * (qyy + qzz), 2.0f * (qxy + qwz),
+            2.0f * (qxz - qwy));
+        const glm::vec3 r1(2.0f * (qxy - qwz), 1.0f - 2.0f * (qxx + qzz),
+            2.0f * (qyz + qwx));
+        const glm::vec3 r2(2.0f * (qxz + qwy), 2.0f * (qyz - qwx),
+            1.0f - 2.0f * (qxx + qyy));
+
+        world[0] = glm::vec4(r0 * s.x, 0.0f);
+        world[1] = glm::vec4(r1 * s.y, 0.0f);
+        world[2] = glm::vec4(r2 * s.z, 0.0f);
+        world[3] = glm::vec4(t, 1.0f);
+
+        if (normal) {
+            (*normal)[0] = r0 * (1.0f / s.x);
+            (*normal)[1] = r1 * (1.0f / s.y);
+            (*normal)[2] = r2 * (1.0f / s.z);
+        }
+    }
+
+    void composeTransformsScalar(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals) {
+        for (std::size_t i = 0; i < count; i++) {
+            composeTransform(translations[i], rotations[i], scales[i], worlds[i],
+                normals ? &normals[i] : nullptr);
+        }
+    }
+
+#ifdef MGL_X86
+
+    ////////////////////////////////////////////////////////////////////////// SSE4
+
+    // Each rotation column is 2 * (a * b + c * d) + e, where a, b, c, d are
+    // shuffles of (x, y, z, w) with some lanes negated and e is the identity
+    // column. The w lane is garbage until blended away.
+#define MGL_SWIZZLE(v, a, b, c) _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, c, b, a))
+
+    enum { QX = 0, QY = 1, QZ = 2, QW = 3 };
+
+    MGL_TARGET("sse4.1")
+    static inline void storeNormalSSE4(glm::mat3& normal, __m128 c0, __m128 c1,
+        __m128 c2) {
+        _mm_storeu_ps(&normal[0][0], c0);
+        _mm_storeu_ps(&normal[1][0], c1);
+        // the last column is stored in two parts to stay within the matrix
+        _mm_storel_pi(reinterpret_cast<__m64*>(&normal[2][0]), c2);
+        _mm_store_ss(&normal[2][2], _mm_movehl_ps(c2, c2));
+    }
+
+    MGL_TARGET("sse4.1")
+    void composeTransformsSSE4(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 e0 = _mm_set_ps(0.0f, 0.0f, 0.0f, 1.0f);
+        const __m128 e1 = _mm_set_ps(0.0f, 0.0f, 1.0f, 0.0f);
+        const __m128 e2 = _mm_set_ps(0.0f, 1.0f, 0.0f, 0.0f);
+        const __m128 sa0 = _mm_set_ps(0.0f, 0.0f, 0.0f, -0.0f);
+        const __m128 sc0 = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+        const __m128 sa1 = _mm_set_ps(0.0f, 0.0f, -0.0f, 0.0f);
+        const __m128 sc1 = _mm_set_ps(0.0f, 0.0f, -0.0f, -0.0f);
+        const __m128 sa2 = _mm_set_ps(0.0f, -0.0f, 0.0f, 0.0f);
+        const __m128 sc2 = _mm_set_ps(0.0f, -0.0f, -0.0f, 0.0f);
+
+        for (std::size_t i = 0; i < count; i++) {
+            const glm::quat& r = rotations[i];
+            const glm::vec3& s = scales[i];
+            const glm::vec3& t = translations[i];
+            const __m128 q = _mm_set_ps(r.w, r.z, r.y, r.x);
+
+            __m128 c0 = _mm_add_ps(
+                _mm_mul_ps(_mm_xor_ps(MGL_SWIZZLE(q, QY, QX, QX), sa0),
+                    MGL_SWIZZLE(q, QY, QY, QZ)),
+                _mm_mul_ps(_mm_xor_ps(MGL_SWIZZLE(q, QZ, QW, QW), sc0),
+                    MGL_SWIZZLE(q, QZ, QZ, QY)));
+            __m128 c1 = _mm_add_ps(
+                _mm_mul_ps(_mm_xor_ps(MGL_SWIZZLE(q, QX, QX, QY), sa1),
+                    MGL_SWIZZLE(q, QY, QX, QZ)),
+                _mm_mul_ps(_mm_xor_ps(MGL_SWIZZLE(q, QW, QZ, QW), sc1),
+                    MGL_SWIZZLE(q, QZ, QZ, QX)));
+            __m128 c2 = _mm_add_ps(
+                _mm_mul_ps(_mm_xor_ps(MGL_SWIZZLE(q, QX, QY, QX), sa2),
+                    MGL_SWIZZLE(q, QZ, QZ, QX)),
+                _mm_mul_ps(_mm_xor_ps(MGL_SWIZZLE(q, QW, QW, QY), sc2),
+                    MGL_SWIZZLE(q, QY, QX, QY)));
+            c0 = _mm_blend_ps(_mm_add_ps(_mm_mul_ps(two, c0), e0), zero, 0x8);
+            c1 = _mm_blend_ps(_mm_add_ps(_mm_mul_ps(two, c1), e1), zero, 0x8);
+            c2 = _mm_blend_ps(_mm_add_ps(_mm_mul_ps(two, c2), e2), zero, 0x8);
+
+            const __m128 sx = _mm_set1_ps(s.x);
+            const __m128 sy = _mm_set1_ps(s.y);
+            const __m128 sz = _mm_set1_ps(s.z);
+            glm::mat4& world = worlds[i];
+            _mm_storeu_ps(&world[0][0], _mm_mul_ps(c0, sx));
+            _mm_storeu_ps(&world[1][0], _mm_mul_ps(c1, sy));
+            _mm_storeu_ps(&world[2][0], _mm_mul_ps(c2, sz));
+            _mm_storeu_ps(&world[3][0], _mm_set_ps(1.0f, t.z, t.y, t.x));
+
+            if (normals) {
+                storeNormalSSE4(normals[i], _mm_mul_ps(c0, _mm_div_ps(one, sx)),
+                    _mm_mul_ps(c1, _mm_div_ps(one, sy)),
+                    _mm_mul_ps(c2, _mm_div_ps(one, sz)));
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////// AVX2
+
+    // Eight nodes per iteration in structure-of-arrays form: each register
+    // holds one component of all eight, loaded and stored with contiguous
+    // accesses and regrouped in registers. The arithmetic is the scalar
+    // path's, term by term.
+
+    // Transposes the 4x4 matrix in each 128-bit lane. Registers holding
+    // vec4 k in the low lane and vec4 k + 4 in the high one become the x, y,
+    // z and w of vec4 0..7, and back.
+    MGL_TARGET("avx2")
+    static inline void transposeAVX2(__m256 a, __m256 b, __m256 c, __m256 d,
+        __m256 out[4]) {
+        const __m256 t0 = _mm256_unpacklo_ps(a, b);
+        const __m256 t1 = _mm256_unpackhi_ps(a, b);
+        const __m256 t2 = _mm256_unpacklo_ps(c, d);
+        const __m256 t3 = _mm256_unpackhi_ps(c, d);
+        out[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+        out[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+        out[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        out[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    }
+
+    // Eight packed vec3 into x, y and z registers.
+    MGL_TARGET("avx2")
+    static inline void loadVec3AVX2(const glm::vec3* v, __m256& x, __m256& y,
+        __m256& z) {
+        const float* f = &v[0].x;
+        const __m256 m0 = _mm256_loadu_ps(f);
+        const __m256 m1 = _mm256_loadu_ps(f + 8);
+        const __m256 m2 = _mm256_loadu_ps(f + 16);
+        // each component sits at different positions in the three loads
+        x = _mm256_permutevar8x32_ps(
+            _mm256_blend_ps(_mm256_blend_ps(m0, m1, 0x92), m2, 0x24),
+            _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+        y = _mm256_permutevar8x32_ps(
+            _mm256_blend_ps(_mm256_blend_ps(m0, m1, 0x24), m2, 0x49),
+            _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+        z = _mm256_permutevar8x32_ps(
+            _mm256_blend_ps(_mm256_blend_ps(m0, m1, 0x49), m2, 0x92),
+            _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+    }
+
+    MGL_TARGET("avx2")
+    void composeTransformsAVX2(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const float* r = &rotations[i].x;
+            const __m256 q01 = _mm256_loadu_ps(r);
+            const __m256 q23 = _mm256_loadu_ps(r + 8);
+            const __m256 q45 = _mm256_loadu_ps(r + 16);
+            const __m256 q67 = _mm256_loadu_ps(r + 24);
+            __m256 q[4];
+            transposeAVX2(_mm256_permute2f128_ps(q01, q45, 0x20),
+                _mm256_permute2f128_ps(q01, q45, 0x31),
+                _mm256_permute2f128_ps(q23, q67, 0x20),
+                _mm256_permute2f128_ps(q23, q67, 0x31), q);
+            __m256 sx, sy, sz, tx, ty, tz;
+            loadVec3AVX2(scales + i, sx, sy, sz);
+            loadVec3AVX2(translations + i, tx, ty, tz);
+
+            const __m256 qxx = _mm256_mul_ps(q[0], q[0]);
+            const __m256 qyy = _mm256_mul_ps(q[1], q[1]);
+            const __m256 qzz = _mm256_mul_ps(q[2], q[2]);
+            const __m256 qxz = _mm256_mul_ps(q[0], q[2]);
+            const __m256 qxy = _mm256_mul_ps(q[0], q[1]);
+            const __m256 qyz = _mm256_mul_ps(q[1], q[2]);
+            const __m256 qwx = _mm256_mul_ps(q[3], q[0]);
+            const __m256 qwy = _mm256_mul_ps(q[3], q[1]);
+            const __m256 qwz = _mm256_mul_ps(q[3], q[2]);
+
+            // rotation column c, row k is rot[c * 3 + k]
+            const __m256 rot[9] = {
+                _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(qyy, qzz))),
+                _mm256_mul_ps(two, _mm256_add_ps(qxy, qwz)),
+                _mm256_mul_ps(two, _mm256_sub_ps(qxz, qwy)),
+                _mm256_mul_ps(two, _mm256_sub_ps(qxy, qwz)),
+                _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(qxx, qzz))),
+                _mm256_mul_ps(two, _mm256_add_ps(qyz, qwx)),
+                _mm256_mul_ps(two, _mm256_add_ps(qxz, qwy)),
+                _mm256_mul_ps(two, _mm256_sub_ps(qyz, qwx)),
+                _mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(qxx, qyy)))
+            };
+            const __m256 s[3] = { sx, sy, sz };
+
+            // columns 0..3 of the eight worlds, each as vec4 k | vec4 k + 4
+            __m256 w[4][4];
+            for (int c = 0; c < 3; c++) {
+                transposeAVX2(_mm256_mul_ps(rot[c * 3], s[c]),
+                    _mm256_mul_ps(rot[c * 3 + 1], s[c]),
+                    _mm256_mul_ps(rot[c * 3 + 2], s[c]), zero, w[c]);
+            }
+            transposeAVX2(tx, ty, tz, one, w[3]);
+            for (int k = 0; k < 4; k++) {
+                glm::mat4& low = worlds[i + k];
+                glm::mat4& high = worlds[i + k + 4];
+                _mm256_storeu_ps(&low[0][0], _mm256_permute2f128_ps(w[0][k], w[1][k], 0x20));
+                _mm256_storeu_ps(&low[2][0], _mm256_permute2f128_ps(w[2][k], w[3][k], 0x20));
+                _mm256_storeu_ps(&high[0][0], _mm256_permute2f128_ps(w[0][k], w[1][k], 0x31));
+                _mm256_storeu_ps(&high[2][0], _mm256_permute2f128_ps(w[2][k], w[3][k], 0x31));
+            }
+
+            if (normals) {
+                __m256 n[3][4];
+                for (int c = 0; c < 3; c++) {
+                    const __m256 inverse = _mm256_div_ps(one, s[c]);
+                    transposeAVX2(_mm256_mul_ps(rot[c * 3], inverse),
+                        _mm256_mul_ps(rot[c * 3 + 1], inverse),
+                        _mm256_mul_ps(rot[c * 3 + 2], inverse), zero, n[c]);
+                }
+                for (int k = 0; k < 4; k++) {
+                    storeNormalSSE4(normals[i + k], _mm256_castps256_ps128(n[0][k]),
+                        _mm256_castps256_ps128(n[1][k]), _mm256_castps256_ps128(n[2][k]));
+                    storeNormalSSE4(normals[i + k + 4], _mm256_extractf128_ps(n[0][k], 1),
+                        _mm256_extractf128_ps(n[1][k], 1), _mm256_extractf128_ps(n[2][k], 1));
+                }
+            }
+        }
+        if (i < count) {
+            composeTransformsSSE4(count - i, translations + i, rotations + i,
+                scales + i, worlds + i, normals ? normals + i : nullptr);
+        }
+    }
+
+#else
+
+    void composeTransformsSSE4(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals) {
+        composeTransformsScalar(count, translations, rotations, scales, worlds,
+            normals);
+    }
+
+    void composeTransformsAVX2(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals) {
+        composeTransformsScalar(count, translations, rotations, scales, worlds,
+            normals);
+    }
+
+#endif
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
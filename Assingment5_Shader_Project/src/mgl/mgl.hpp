@@ -15,14 +15,32 @@
 #include <GLFW/glfw3.h>
 
 #include "./mglApp.hpp"
+#include "./mglBenchmark.hpp"
 #include "./mglCamera.hpp"
+#include "./mglContext.hpp"
 #include "./mglConventions.hpp"
 #include "./mglError.hpp"
+#include "./mglFile.hpp"
+#include "./mglFrameStats.hpp"
+#include "./mglGeometryPool.hpp"
+#include "./mglGpuScene.hpp"
 #include "./mglKeyBuffer.hpp"
 #include "./mglManager.hpp"
 #include "./mglMesh.hpp"
+#include "./mglMeshlet.hpp"
+#include "./mglMeshOptimizer.hpp"
 #include "./mglOrbitCamera.hpp"
+#include "./mglPool.hpp"
+#include "./mglProfiler.hpp"
+#include "./mglRingBuffer.hpp"
 #include "./mglScenegraph.hpp"
 #include "./mglShader.hpp"
+#include "./mglShaderVariants.hpp"
+#include "./mglSnapshot.hpp"
+#include "./mglSpscQueue.hpp"
+#include "./mglStaticBatch.hpp"
+#include "./mglTransform.hpp"
+#include "./mglTripleBuffer.hpp"
+#include "./mglVertexFormat.hpp"
 
 #endif /* MGL_HPP */
\ No newline at end of file
@@ -12,19 +12,51 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <glm/glm.hpp>
 
+#include "./mglContext.hpp"
+#include "./mglFrameStats.hpp"
+#include "./mglSpscQueue.hpp"
+
 namespace mgl {
 
     class App;
     class Engine;
 
+    //////////////////////////////////////////////////////////////////// RenderEvent
+
+    // Input that needs the GL context, sent from the main thread to the
+    // render thread. RESIZE carries the new size in x and y; PICK carries
+    // a window position with y pointing up.
+    struct RenderEvent {
+        enum Type {
+            RESIZE,
+            PICK
+        };
+        Type type;
+        double x, y;
+    };
+
     //////////////////////////////////////////////////////////////////////////// App
 
+    // In a threaded engine, input callbacks, updateCallback and
+    // publishCallback run on the main thread without a GL context, while
+    // renderCallback and renderEventCallback run on the render thread.
+    // displayCallback is only used by the single-threaded engine.
     class App {
     public:
         virtual void initCallback(GLFWwindow* window) {}
+        virtual void updateCallback(GLFWwindow* window, double step) {}
         virtual void displayCallback(GLFWwindow* window, double elapsed) {}
+        virtual void publishCallback(GLFWwindow* window) {}
+        virtual void renderCallback(GLFWwindow* window, double elapsed) {}
+        virtual void renderEventCallback(GLFWwindow* window,
+            const RenderEvent& event) {}
         virtual void windowCloseCallback(GLFWwindow* window) {}
         virtual void windowSizeCallback(GLFWwindow* window, int width, int height) {}
         virtual void cursorCallback(GLFWwindow* window, double xpos, double ypos) {}
@@ -39,6 +71,11 @@ namespace mgl {
 
     ///////////////////////////////////////////////////////////////////////// Engine
 
+    enum RedrawMode {
+        CONTINUOUS,
+        ON_DEMAND
+    };
+
     class Engine {
     public:
         uint16_t WindowWidth, WindowHeight;
@@ -50,8 +87,20 @@ namespace mgl {
         void setOpenGL(int major, int minor);
         void setWindow(int width, int height, const char* title, int fullscreen,
             int vsync);
+        void setHeadless(int frames, double seconds, const char* snapshot);
+        bool isHeadless();
+        void setFixedStep(double seconds);
+        void setFrameLimit(double fps);
+        FrameStats getFrameStats();
+        void setRedrawMode(RedrawMode mode, double timeout);
+        void requestRedraw();
+        void wake();
+        void setThreaded(bool threaded);
+        bool isThreaded();
+        void postRenderEvent(const RenderEvent& event);
         void init();
         void run();
+        void close();
 
     protected:
         virtual ~Engine();
@@ -65,11 +114,61 @@ namespace mgl {
         int Fullscreen;
         int Vsync;
 
+        // Headless [surfaceless context or hidden window, renders into an FBO]
+        bool Headless;
+        int HeadlessFrames;
+        double HeadlessSeconds;
+        const char* HeadlessSnapshot;
+        SurfacelessContext Surfaceless;
+        std::atomic<bool> Closing;
+        GLuint FramebufferId, ColorBufferId, DepthStencilBufferId;
+
+        // Pacing [fixed-step updates, frame limiter]
+        double FixedStep, Accumulator;
+        double FrameLimit, SleepError;
+        FrameStats Stats;
+        std::mutex StatsMutex;
+
+        // Redraw [on demand: sleep in glfwWaitEvents until something changes]
+        RedrawMode Redraw;
+        double RedrawTimeout;
+        std::atomic<bool> RedrawRequested;
+        std::atomic<bool> WakeRequested;
+        std::atomic<bool> Running;
+
+        // Run statistics
+        double StartTime;
+        int Frames;
+
+        // Render thread [owns the GL context, main thread keeps GLFW events]
+        bool Threaded;
+        std::thread::id MainThread;
+        bool PendingRedraw;
+        std::atomic<bool> Rendering;
+        SpscQueue<RenderEvent, 64> RenderEvents;
+        std::mutex RenderMutex;
+        std::condition_variable RenderSignal;
+
         void setupWindow();
+        void setupHints();
         void setupGLFW();
         void setupGLEW();
         void setupOpenGL();
         void setupCallbacks();
+        void setupFramebuffer();
+        bool shouldClose();
+        void makeCurrent(bool current);
+        void destroyFramebuffer();
+        void saveSnapshot(const char* filename);
+        void update(double elapsed);
+        void limitFrame(double frame_start);
+        void present();
+        void handleRenderEvent(const RenderEvent& event);
+        void signalRender();
+        double getIdleTimeout();
+        void runSingle();
+        void runThreaded();
+        void renderLoop();
 
     public:
         Engine(Engine const&) = delete;
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Scene Benchmark Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_BENCHMARK_HPP
+#define MGL_BENCHMARK_HPP
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "./mglScenegraph.hpp"
+
+namespace mgl {
+
+    class Benchmark;
+
+    ////////////////////////////////////////////////////////////////////// BENCHMARK
+
+    enum Distribution {
+        UNIFORM,
+        NORMAL
+    };
+
+    // Generates synthetic scenegraphs of increasing size and times each
+    // stage of a frame separately. Meshes and shaders must already be in
+    // their managers; they are picked per node with the given weights.
+    class Benchmark {
+    public:
+        struct Config {
+            std::vector<size_t> nodeCounts = { 1000, 10000, 100000, 1000000 };
+            std::vector<std::string> meshes = { "cube" };
+            std::vector<double> meshWeights = { 1.0 };
+            std::vector<std::string> shaders = { "phong" };
+            std::vector<double> shaderWeights = { 1.0 };
+
+            // Transforms [positions spread around the origin]
+            Distribution positions = Distribution::UNIFORM;
+            float spread = 50.0f;
+            float minScale = 0.1f, maxScale = 1.0f;
+            bool rotate = true;
+
+            // GPU-driven scenegraphs when set [ID of the culling program]
+            std::string culling;
+
+            int frames = 10;
+            bool saveAndLoad = true;
+            unsigned int seed = 1;
+        };
+
+        struct Result {
+            size_t nodes = 0;
+            size_t visible = 0;
+            double generate = 0.0;
+            double save = 0.0;
+            double load = 0.0;
+            double update = 0.0;
+            double cull = 0.0;
+            double submit = 0.0;
+        };
+
+        explicit Benchmark(const Config& config);
+        void run(GLuint bindingpoint);
+        void save(const std::string& filename);
+
+    private:
+        Config config;
+        std::vector<Result> results;
+
+        Scenegraph* generate(size_t count, GLuint bindingpoint);
+        void setupCamera(Scenegraph* scenegraph);
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_BENCHMARK_HPP */
@@ -21,19 +21,26 @@ namespace mgl {
 
 	class Camera {
 	private:
-		GLuint UboId;
+		GLuint BindingPoint;
 		glm::mat4 ViewMatrix;
 		glm::mat4 ProjectionMatrix;
 
 	public:
 		explicit Camera(GLuint bindingpoint);
 		virtual ~Camera();
+		GLuint getBindingPoint();
 		glm::mat4 getViewMatrix();
 		void setViewMatrix(const glm::mat4& viewmatrix);
 		glm::mat4 getProjectionMatrix();
 		void setProjectionMatrix(const glm::mat4& projectionmatrix);
+		void upload();
 	};
 
+	// Writes the camera block [view, projection] into the ring buffer and
+	// binds it; for renderers that keep the matrices outside a Camera.
+	void uploadCamera(GLuint bindingpoint, const glm::mat4& viewmatrix,
+		const glm::mat4& projectionmatrix);
+
 	////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
 
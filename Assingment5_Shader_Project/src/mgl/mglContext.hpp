@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Surfaceless OpenGL Context
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_CONTEXT_HPP
+#define MGL_CONTEXT_HPP
+
+namespace mgl {
+
+    class SurfacelessContext;
+
+    //////////////////////////////////////////////////////////// SURFACELESS CONTEXT
+
+    // OpenGL context without a window or a display server, for headless
+    // runs drawing into their own framebuffer. Made through EGL on the
+    // EGL_MESA_platform_surfaceless platform, current without a surface
+    // where EGL_KHR_surfaceless_context allows, else on a pbuffer. Only on
+    // Linux; create() fails elsewhere.
+    class SurfacelessContext {
+    public:
+        SurfacelessContext();
+        ~SurfacelessContext();
+        SurfacelessContext(SurfacelessContext const&) = delete;
+        void operator=(SurfacelessContext const&) = delete;
+
+        bool create(int major, int minor, bool debug, int width, int height);
+        void destroy();
+        bool isCreated();
+        bool makeCurrent(bool current);
+
+    private:
+        // EGL handles, kept opaque so that EGL stays out of this header
+        void* Display;
+        void* Context;
+        void* Surface;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_CONTEXT_HPP */
@@ -24,6 +24,11 @@ namespace mgl {
 	const char PROJECTION_MATRIX[] = "ProjectionMatrix";
 	const char TEXTURE_MATRIX[] = "TextureMatrix";
 	const char CAMERA_BLOCK[] = "Camera";
+	const char FRAME_BLOCK[] = "Frame";
+	const char OBJECT_BLOCK[] = "Object";
+	const char VIEW_PROJECTION_MATRIX[] = "ViewProjectionMatrix";
+	const char PROJECTION_SCALE[] = "ProjectionScale";
+	const char NODE_COUNT[] = "NodeCount";
 
 	const char POSITION_ATTRIBUTE[] = "inPosition";
 	const char NORMAL_ATTRIBUTE[] = "inNormal";
@@ -32,6 +37,14 @@ namespace mgl {
 	const char BITANGENT_ATTRIBUTE[] = "inBitangent";
 	const char COLOR_ATTRIBUTE[] = "inColor";
 
+	const char NORMALS_DEFINE[] = "HAS_NORMALS";
+	const char TEXCOORDS_DEFINE[] = "HAS_TEXCOORDS";
+	const char TANGENTS_DEFINE[] = "HAS_TANGENTS";
+	const char COMPRESSED_DEFINE[] = "COMPRESSED_VERTICES";
+	const char VERTEX_COLORS_DEFINE[] = "VERTEX_COLORS";
+	const char INSTANCING_DEFINE[] = "INSTANCING";
+	const char SKINNING_DEFINE[] = "SKINNING";
+
 	////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
 
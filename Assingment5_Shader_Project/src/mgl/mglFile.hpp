@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// File Utilities
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_FILE_HPP
+#define MGL_FILE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+    class FileWatcher;
+    class MappedFile;
+
+    //////////////////////////////////////////////////////////////////// MAPPED FILE
+
+    // Read-only view of a whole file, paged in by the OS on first touch.
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+        MappedFile(MappedFile const&) = delete;
+        void operator=(MappedFile const&) = delete;
+
+        bool open(const std::string& filename);
+        void close();
+        const unsigned char* data();
+        std::size_t size();
+
+    private:
+        const unsigned char* Data;
+        std::size_t Size;
+#ifdef _WIN32
+        void* File;
+        void* Mapping;
+#else
+        int File;
+#endif
+    };
+
+    /////////////////////////////////////////////////////////////////// FILE WATCHER
+
+    // Reports the watched files written since the last poll(), which never
+    // blocks. On Linux inotify watches their directories, so editors that
+    // save by renaming a new file over the old one are seen too; elsewhere
+    // the modification times are compared, at most every CHECK_SECONDS.
+    class FileWatcher {
+    public:
+        static constexpr double CHECK_SECONDS = 0.25;
+
+        FileWatcher();
+        ~FileWatcher();
+        FileWatcher(FileWatcher const&) = delete;
+        void operator=(FileWatcher const&) = delete;
+
+        void watch(const std::string& filename);
+        bool poll(std::vector<std::string>& changed);
+
+    private:
+        // Files [name as watched -> modification time]
+        std::map<std::string, std::int64_t> Files;
+#ifdef __linux__
+        int Inotify;
+        // Directories [watch descriptor -> directory]
+        std::map<int, std::string> Directories;
+#else
+        std::chrono::steady_clock::time_point LastCheck;
+#endif
+    };
+
+    ////////////////////////////////////////////////////////////////////////// Extra
+
+    // XXH64; chain calls by passing the previous hash as seed. Four
+    // independent lanes per 32-byte stripe keep the multipliers busy, so
+    // large buffers hash at several bytes per cycle.
+    std::uint64_t hashBytes(const void* data, std::size_t size,
+        std::uint64_t seed = 0);
+
+    // Creates every missing directory in path; true if it exists afterwards.
+    bool createDirectory(const std::string& path);
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_FILE_HPP */
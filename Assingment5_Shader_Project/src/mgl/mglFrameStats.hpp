@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Time Statistics
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_FRAME_STATS_HPP
+#define MGL_FRAME_STATS_HPP
+
+#include <cstddef>
+
+namespace mgl {
+
+    class FrameStats;
+
+    //////////////////////////////////////////////////////////////////// FRAME STATS
+
+    // Rolling window of the last WINDOW frame times, kept both as raw samples
+    // and as a histogram so that percentiles cost O(BUCKETS) per query.
+    class FrameStats {
+    public:
+        static const size_t WINDOW = 512;
+        static const size_t BUCKETS = 256;
+        static constexpr double BUCKET_WIDTH = 0.25;  // ms
+
+        FrameStats();
+        void add(double seconds);
+        void reset();
+
+        size_t getCount() const;
+        double getMean() const;      // ms
+        double getMin() const;       // ms
+        double getMax() const;       // ms
+        double getPercentile(double p) const;  // ms, p in [0, 100]
+        const unsigned int* getHistogram() const;
+
+    private:
+        double samples[WINDOW];
+        size_t next, count;
+        double sum;
+        unsigned int histogram[BUCKETS];
+
+        static size_t bucket(double ms);
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_FRAME_STATS_HPP */
@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Shared Geometry Pool Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_GEOMETRY_POOL_HPP
+#define MGL_GEOMETRY_POOL_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "./mglVertexFormat.hpp"
+
+namespace mgl {
+
+    class RangeAllocator;
+    class GeometryPool;
+
+    //////////////////////////////////////////////////////////////// RANGE ALLOCATOR
+
+    // Best-fit sub-allocator of [0, capacity) in abstract units. Free blocks
+    // are indexed by offset, to merge with their neighbours when freed, and
+    // by size, to find the smallest one that fits in O(log n).
+    class RangeAllocator {
+    public:
+        static const size_t NONE = ~size_t(0);
+
+        RangeAllocator();
+        void reset(size_t capacity);
+        void grow(size_t capacity);
+        size_t allocate(size_t size);
+        void free(size_t offset);
+
+        size_t getCapacity();
+        size_t getUsed();
+        size_t getLargestFree();
+        size_t getFreeBlocks();
+
+    private:
+        std::map<size_t, size_t> FreeByOffset;
+        std::set<std::pair<size_t, size_t>> FreeBySize;
+        std::map<size_t, size_t> Used;
+        size_t Capacity, UsedSize;
+
+        void insertFree(size_t offset, size_t size);
+        void eraseFree(std::map<size_t, size_t>::iterator block);
+    };
+
+    ////////////////////////////////////////////////////////////////// GEOMETRY POOL
+
+    // Where a mesh lives in the pool. Offsets are in units of the arena
+    // buffers, so they go straight into glDrawElementsBaseVertex: vertex v
+    // is at firstVertex + v * vertexUnits, where a unit is a vertex, or a
+    // 32-bit word when the pool pulls vertices. defragment() may move them,
+    // so they are read at draw time. Meshes with the same content key share
+    // one allocation, freed with the last of them.
+    struct GeometryAllocation {
+        size_t arena = 0;
+        GLuint layout = 0;
+        size_t vertexUnits = 1;
+        size_t firstVertex = 0, vertexCount = 0;
+        size_t firstIndex = 0, indexCount = 0;
+        std::uint64_t key = 0;
+        size_t references = 1;
+    };
+
+    struct GeometryPoolStats {
+        size_t arenas = 0;
+        size_t allocations = 0;
+        size_t vertexBytes = 0, vertexCapacity = 0;
+        size_t indexBytes = 0, indexCapacity = 0;
+        size_t freeBlocks = 0;
+        // bytes that meshes sharing an allocation would have uploaded again
+        size_t sharedBytes = 0, sharedMeshes = 0;
+        // 1 - largest free block / all free space, summed over buffers
+        double fragmentation = 0.0;
+    };
+
+    // Every mesh of a vertex format shares one VAO, one vertex buffer and
+    // one index buffer (an arena), so drawing a scene switches VAOs once per
+    // format instead of once per mesh. Buffers grow by doubling; freed
+    // ranges are merged and reused, and defragment() packs an arena when
+    // its free space is too scattered. Needs the GL context.
+    //
+    // With vertex pulling every format shares a single arena whose VAO has
+    // no attributes, only the index buffer: vertex shaders read the vertex
+    // buffer as 32-bit words from a storage block and decode them with the
+    // layout table [see bindStorage()], so meshes of different formats can
+    // be drawn by the same call.
+    class GeometryPool {
+    public:
+        static GeometryPool& getInstance();
+
+        void setVertexPulling(bool pulling);
+        bool isVertexPulling();
+        GeometryAllocation* allocate(const VertexLayout& layout,
+            size_t vertexCount, size_t indexCount, std::uint64_t key = 0);
+        GeometryAllocation* acquire(const VertexLayout& layout, std::uint64_t key,
+            size_t vertexCount, size_t indexCount);
+        void upload(GeometryAllocation* allocation, const void* vertices,
+            const unsigned int* indices);
+        void free(GeometryAllocation* allocation);
+        void bind(const GeometryAllocation* allocation);
+        void bindArena(size_t arena);
+        void bindStorage(GLuint vertexBinding, GLuint layoutBinding);
+        void defragment();
+        size_t getLayoutVersion();
+
+        GeometryPoolStats getStats();
+        void printStats();
+
+    private:
+        // std430 layout table of bindStorage(): the stride in words, then
+        // per location (offset in bytes, GL type, components, normalized)
+        struct LayoutData {
+            GLuint stride[4];
+            GLuint attributes[VertexLayout::MAX_ATTRIBUTES][4];
+        };
+
+        struct Arena {
+            GLuint layout;
+            GLsizei stride;
+            GLuint vao, vertexBuffer, indexBuffer;
+            RangeAllocator vertices, indices;
+            std::vector<std::unique_ptr<GeometryAllocation>> allocations;
+        };
+
+        static const size_t INITIAL_VERTICES = 1 << 16;
+        static const size_t INITIAL_INDICES = 1 << 18;
+
+        std::vector<std::unique_ptr<Arena>> Arenas;
+        std::map<std::uint64_t, GeometryAllocation*> Keys;
+        std::vector<VertexLayout> Layouts;
+        GLuint BoundVao;
+        bool Immutable;
+        // Pulling [one arena of words for every format]
+        bool Pulling;
+        GLuint LayoutBuffer;
+        size_t LayoutsUploaded;
+        // bumped whenever allocations move, for copies of their offsets
+        size_t LayoutVersion;
+
+        GeometryPool();
+        ~GeometryPool();
+        GLuint getLayout(const VertexLayout& layout);
+        size_t getArena(GLuint layout);
+        GLuint createBuffer(size_t bytes);
+        GLuint resizeBuffer(GLuint buffer, size_t copyBytes, size_t bytes);
+        void attachBuffers(Arena& arena);
+        void growRange(Arena& arena, RangeAllocator& range, GLuint& buffer,
+            size_t unit, size_t count);
+        void defragment(Arena& arena);
+
+    public:
+        GeometryPool(GeometryPool const&) = delete;
+        void operator=(GeometryPool const&) = delete;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_GEOMETRY_POOL_HPP */
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// GPU-Driven Scene Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_GPU_SCENE_HPP
+#define MGL_GPU_SCENE_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "./mglMeshlet.hpp"
+
+namespace mgl {
+
+    class GpuScene;
+    class Mesh;
+    class ShaderProgram;
+    struct FrameConstants;
+
+    ////////////////////////////////////////////////////////////////////// GPU SCENE
+
+    // Nodes kept in storage buffers and drawn without walking them on the
+    // CPU. A node is uploaded again only when it changes; every frame a
+    // compute shader composes the node matrices, culls the nodes and their
+    // ranges [submeshes or meshlets] against the frustum, picks a level of
+    // detail and appends a command per surviving range to its batch. A
+    // batch is every node of one pool arena and shader, drawn with one
+    // glMultiDrawElementsIndirectCount, so the CPU cost of a frame grows
+    // with the batches and the changed nodes, not with the node count.
+    //
+    // The culling program is built by the app from cull-cs.glsl. Shaders
+    // drawn this way read their Object from the Objects storage block at
+    // gl_BaseInstance. When the geometry pool pulls vertices, all meshes
+    // are in one arena, so a batch is every node of one shader, and the
+    // shaders fetch their vertices as phong-pull-vs.glsl does. Meshes must be uploaded, with their levels of
+    // detail added, before their first node, and outlive the scene. Needs
+    // a GL 4.6 context.
+    class GpuScene {
+    public:
+        static const GLuint OBJECT_BINDING = 0;
+        static const GLuint NODE_BINDING = 1;
+        static const GLuint MESH_BINDING = 2;
+        static const GLuint RANGE_BINDING = 3;
+        static const GLuint BATCH_BINDING = 4;
+        static const GLuint COMMAND_BINDING = 5;
+        static const GLuint COUNT_BINDING = 6;
+        static const GLuint VERTEX_BINDING = 7;
+        static const GLuint LAYOUT_BINDING = 8;
+        static const size_t MAX_LODS = 4;
+
+        static bool isSupported();
+
+        explicit GpuScene(ShaderProgram* culling);
+        ~GpuScene();
+        GpuScene(GpuScene const&) = delete;
+        void operator=(GpuScene const&) = delete;
+
+        void resize(size_t count);
+        void setNode(size_t index, const glm::vec3& translation,
+            const glm::quat& rotation, const glm::vec3& scaling,
+            const glm::vec3& color, Mesh* mesh, ShaderProgram* shader);
+        void cull(const glm::mat4& view, const glm::mat4& projection,
+            const glm::vec3& eye);
+        void draw(FrameConstants& frame);
+
+        size_t getNodeCount();
+        size_t getBatchCount();
+
+    private:
+        static const GLuint NO_MESH = 0xFFFFFFFF;
+        static const size_t WORKGROUP_SIZE = 64;
+
+        // std430 layouts of cull-cs.glsl
+        struct NodeData {
+            glm::vec4 translation;
+            glm::vec4 rotation;
+            glm::vec4 scaling;
+            glm::vec4 color;
+            GLuint mesh;
+            GLuint batch;
+            GLuint padding[2];
+        };
+
+        struct MeshRecord {
+            glm::mat4 positionMatrix;
+            glm::vec4 sphere;
+            glm::vec4 lodScreenSize;
+            GLuint firstRange[MAX_LODS];
+            GLuint rangeCount[MAX_LODS];
+            GLuint lodCount;
+            GLuint layout;
+            GLuint padding[2];
+        };
+
+        // Nodes of one arena and shader; commands [offset, offset + capacity)
+        struct Batch {
+            size_t arena;
+            ShaderProgram* shader;
+            size_t nodes;
+            size_t capacity;
+            size_t offset;
+        };
+
+        ShaderProgram* Culling;
+
+        // Nodes [CPU copy, written to the GPU in runs of changed nodes]
+        std::vector<NodeData> Nodes;
+        std::vector<size_t> Changed;
+        size_t NodeCapacity;
+
+        // Meshes [ranges of every level, with pool offsets]
+        std::map<Mesh*, GLuint> MeshIndex;
+        std::vector<Mesh*> MeshList;
+        std::vector<MeshRecord> MeshRecords;
+        std::vector<GLuint> MeshCapacity;
+        std::vector<Meshlet> Ranges;
+        bool MeshesChanged;
+        size_t LayoutVersion;
+
+        std::map<std::pair<size_t, ShaderProgram*>, GLuint> BatchIndex;
+        std::vector<Batch> Batches;
+        bool BatchesChanged;
+        size_t CommandCapacity;
+
+        GLuint ObjectBuffer, NodeBuffer, MeshBuffer, RangeBuffer;
+        GLuint BatchBuffer, CommandBuffer, CountBuffer;
+
+        GLuint getMesh(Mesh* mesh);
+        void buildMesh(GLuint index);
+        GLuint getBatch(Mesh* mesh, ShaderProgram* shader);
+        void retire(size_t index);
+        void uploadMeshes();
+        void uploadBatches();
+        void uploadNodes();
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_GPU_SCENE_HPP */
@@ -9,21 +9,37 @@
 #ifndef MGL_MANAGER_HPP
 #define MGL_MANAGER_HPP
 
-#include <string>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "./mglFile.hpp"
 #include "./mglMesh.hpp"
 #include "./mglShader.hpp"
 
 namespace mgl {
 
+    class ShaderVariants;
+
     //////////////////////////////////////////////////////////////////////// MANAGER
 
+    // Thread-safe: the main thread looks objects up while the GL context
+    // thread adds the ones it finishes. get() returns nullptr for a key
+    // that was never added.
     template<class E>
     class Manager {
     protected:
         Manager();
         std::map<std::string, E*> objects;
+        std::mutex objectsMutex;
 
     public:
         static Manager<E>& getInstance();
@@ -48,16 +64,20 @@ namespace mgl {
 
     template<class E>
     void Manager<E>::add(const std::string& key, E* object) {
+        std::lock_guard<std::mutex> lock(objectsMutex);
         objects[key] = object;
     }
 
     template<class E>
     E* Manager<E>::get(const std::string& key) {
-        return objects[key];
+        std::lock_guard<std::mutex> lock(objectsMutex);
+        auto found = objects.find(key);
+        return found == objects.end() ? nullptr : found->second;
     }
 
     template<class E>
     void Manager<E>::display() {
+        std::lock_guard<std::mutex> lock(objectsMutex);
         for (auto o : objects) {
             std::cout << "key: " << o.first << std::endl;
         }
@@ -65,11 +85,97 @@ namespace mgl {
 
     ///////////////////////////////////////////////////////////////// SHADER MANAGER
 
-    class ShaderManager : public Manager<ShaderProgram> {};
+    // Once watch() is called, the files of every program are watched and
+    // update(), which the engine calls each loop on the GL context thread,
+    // reloads the programs whose files changed; an engine idle on demand
+    // wakes within getIdleTimeout() to call it. Their new versions compile
+    // in the background where the driver can, and go live only if they
+    // link; until then, and after an error, the old ones keep drawing.
+    // Variants are looked up with the features wanted, and build the
+    // program that has them on first use [see ShaderVariants].
+    class ShaderManager : public Manager<ShaderProgram> {
+    public:
+        static constexpr double RELOAD_CHECK_SECONDS = 0.02;
+
+        static ShaderManager& getInstance();
+
+        using Manager<ShaderProgram>::get;
+        void add(const std::string& key, ShaderProgram* shader);
+        void addVariants(ShaderVariants* shaders);
+        ShaderProgram* get(const std::string& key, unsigned int features);
+        void watch();
+        void update();
+        double getIdleTimeout();
+
+    private:
+        std::unique_ptr<FileWatcher> watcher;
+        std::vector<std::string> changed;
+        std::vector<ShaderProgram*> reloading;
+        std::map<std::string, ShaderVariants*> variants;
+
+        ShaderManager();
+
+    public:
+        ShaderManager(ShaderManager const&) = delete;
+        void operator=(ShaderManager const&) = delete;
+    };
 
     /////////////////////////////////////////////////////////////////// MESH MANAGER
 
-    class MeshManager : public Manager<Mesh> {};
+    // Loads meshes on worker threads. A queued mesh, its options already
+    // set, is imported and processed by a worker; its buffers are made by
+    // upload() on the GL context thread, which the engine calls each loop,
+    // drawing or not; workers wake it when it idles on demand. Then, on that
+    // thread, the mesh is added under its key, a redraw is requested, the
+    // future is made ready and the callback runs. A mesh that fails is reported and
+    // deleted, and its future holds nullptr. Futures are only made ready by
+    // upload(), so the context thread waits with wait(), not future::get().
+    class MeshManager : public Manager<Mesh> {
+    public:
+        typedef std::function<void(const std::string& key, Mesh* mesh,
+            const std::string& error)> LoadCallback;
+
+        struct LoadRequest {
+            std::string key;
+            std::string filename;
+            Mesh* mesh = nullptr;
+            LoadCallback callback;
+        };
+
+        static MeshManager& getInstance();
+        ~MeshManager();
+
+        std::future<Mesh*> load(const std::string& key, const std::string& filename,
+            Mesh* mesh, LoadCallback callback = nullptr);
+        std::vector<std::future<Mesh*>> load(const std::vector<LoadRequest>& requests);
+        size_t upload(size_t budget = SIZE_MAX);
+        void wait();
+        size_t getPendingCount();
+
+    private:
+        struct Job {
+            LoadRequest request;
+            std::promise<Mesh*> promise;
+            bool loaded = false;
+        };
+
+        std::vector<std::thread> workers;
+        std::deque<std::unique_ptr<Job>> jobs;
+        std::deque<std::unique_ptr<Job>> uploads;
+        std::mutex mutex;
+        std::condition_variable jobReady;
+        std::condition_variable uploadReady;
+        size_t pending = 0;
+        bool stopping = false;
+
+        MeshManager();
+        void work();
+        void finish(Job& job);
+
+    public:
+        MeshManager(MeshManager const&) = delete;
+        void operator=(MeshManager const&) = delete;
+    };
 
     ////////////////////////////////////////////////////////////////////////////////
 }  // namespace mgl
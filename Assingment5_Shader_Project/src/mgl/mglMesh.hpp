@@ -19,7 +19,11 @@
 #include <string>
 #include <vector>
 
+#include "./mglFile.hpp"
+#include "./mglGeometryPool.hpp"
+#include "./mglMeshlet.hpp"
 #include "./mglScenegraph.hpp"
+#include "./mglVertexFormat.hpp"
 
 namespace mgl {
 
@@ -29,6 +33,21 @@ namespace mgl {
 
     /////////////////////////////////////////////////////////////////////////// Mesh
 
+    // What stays on the CPU after upload: nothing, every attribute and the
+    // indices, or only the positions and indices needed to pick on the CPU.
+    enum VertexRetention {
+        DROP,
+        KEEP,
+        KEEP_FOR_PICKING
+    };
+
+    // A coarser mesh drawn instead once the mesh covers less than
+    // screenSize of the viewport height.
+    struct MeshLod {
+        Mesh* mesh;
+        float screenSize;
+    };
+
     class Mesh : public IDrawable {
     public:
         static const GLuint INDEX = 0;
@@ -39,6 +58,7 @@ namespace mgl {
 #ifdef CREATE_BITANGENT
         static const GLuint BITANGENT = 5;
 #endif
+        static const GLuint COLOR = 6;
 
         Mesh();
         ~Mesh();
@@ -50,23 +70,125 @@ namespace mgl {
         void generateTexcoords();
         void calculateTangentSpace();
         void flipUVs();
+        void compressVertices();
+        void optimize();
+        void splitMeshlets();
+        void setCacheDirectory(const std::string& directory);
+        void setRetention(VertexRetention retention);
+        void addLod(Mesh* lod, float screenSize);
 
         void create(const std::string& filename);
+        bool load(const std::string& filename);
+        void upload();
+        const std::string& getError();
         void draw() override;
+        void drawMeshlets(const glm::mat4& modelViewProjection, const glm::vec3& eye);
 
         bool hasNormals();
         bool hasTexcoords();
         bool hasTangentsAndBitangents();
+        glm::vec3 getCenter();
+        float getRadius();
+        GLsizei getVertexStride();
+        bool hasCompressedVertices();
+        unsigned int getShaderFeatures();
+        bool isShared();
+        bool hasMeshlets();
+        size_t getMeshletCount();
+        glm::mat4 getPositionMatrix();
+        const std::vector<glm::vec3>& getPositions();
+        const std::vector<unsigned int>& getIndices();
+        const std::vector<MeshLod>& getLods();
+        const GeometryAllocation* getGeometry();
+        void appendDrawRanges(std::vector<Meshlet>& out);
+        bool appendTransformed(const glm::mat4& world, std::vector<glm::vec3>& positions,
+            std::vector<glm::vec3>& normals, std::vector<unsigned int>& indices);
 
     private:
-        GLuint VaoId;
+        // Vertex Formats [interleaved, chosen from the attributes loaded]
+        typedef FloatAttribute<POSITION, glm::vec3, &VertexSource::positions>
+            PositionAttribute;
+        typedef FloatAttribute<NORMAL, glm::vec3, &VertexSource::normals>
+            NormalAttribute;
+        typedef FloatAttribute<TEXCOORD, glm::vec2, &VertexSource::texcoords>
+            TexcoordAttribute;
+        typedef FloatAttribute<TANGENT, glm::vec3, &VertexSource::tangents>
+            TangentAttribute;
+#ifdef CREATE_BITANGENT
+        typedef FloatAttribute<BITANGENT, glm::vec3, &VertexSource::bitangents>
+            BitangentAttribute;
+#endif
+
+        typedef VertexFormat<PositionAttribute> PFormat;
+        typedef VertexFormat<PositionAttribute, NormalAttribute> PNFormat;
+        typedef VertexFormat<PositionAttribute, TexcoordAttribute> PTFormat;
+        typedef VertexFormat<PositionAttribute, NormalAttribute, TexcoordAttribute>
+            PNTFormat;
+#ifdef CREATE_BITANGENT
+        typedef VertexFormat<PositionAttribute, NormalAttribute, TexcoordAttribute,
+            TangentAttribute, BitangentAttribute> PNTTBFormat;
+#else
+        typedef VertexFormat<PositionAttribute, NormalAttribute, TexcoordAttribute,
+            TangentAttribute> PNTTBFormat;
+#endif
+
+        // Compressed Vertex Formats [quantized, bitangent from a sign in w]
+        typedef QuantizedPositionAttribute<POSITION> PackedPositionAttribute;
+        typedef OctahedralAttribute<NORMAL, &VertexSource::normals>
+            PackedNormalAttribute;
+        typedef HalfAttribute<TEXCOORD, &VertexSource::texcoords>
+            PackedTexcoordAttribute;
+        typedef OctahedralTangentAttribute<TANGENT> PackedTangentAttribute;
+
+        typedef VertexFormat<PackedPositionAttribute> PPackedFormat;
+        typedef VertexFormat<PackedPositionAttribute, PackedNormalAttribute>
+            PNPackedFormat;
+        typedef VertexFormat<PackedPositionAttribute, PackedTexcoordAttribute>
+            PTPackedFormat;
+        typedef VertexFormat<PackedPositionAttribute, PackedNormalAttribute,
+            PackedTexcoordAttribute> PNTPackedFormat;
+        typedef VertexFormat<PackedPositionAttribute, PackedNormalAttribute,
+            PackedTexcoordAttribute, PackedTangentAttribute> PNTTBPackedFormat;
+
+        GeometryAllocation* Geometry;
+        GLsizei VertexStride;
+        size_t VertexCount;
         unsigned int AssimpFlags;
         bool NormalsLoaded, TexcoordsLoaded, TangentsAndBitangentsLoaded;
+        bool VerticesCompressed;
+        bool Optimized;
+        bool Clustered;
+        VertexRetention Retention;
+
+        // Cooked Mesh Cache [empty directory disables it]
+        std::string CacheDirectory;
+        glm::uint64 CookedKey;
+
+        // Content Key [hash of the packed vertices and indices, shared by
+        // meshes with identical geometry]
+        glm::uint64 ContentKey;
+
+        // Staging [what load() left for upload(), a cooked file or packed
+        // vertices with Indices]
+        MappedFile CookedFile;
+        std::vector<unsigned char> StagedVertices;
+        const void* StagedVertexData;
+        const unsigned int* StagedIndexData;
+        size_t StagedIndexCount;
+        std::string Error;
+
+        // Bounding Sphere [model space]
+        glm::vec3 Center;
+        float Radius;
+
+        // Bounding Box [model space, extent never 0 so it can be divided by]
+        glm::vec3 BoundsMin, BoundsExtent;
 
         struct MeshData {
             unsigned int nIndices = 0;
             unsigned int baseIndex = 0;
             unsigned int baseVertex = 0;
+            unsigned int nVertices = 0;
         };
         std::vector<MeshData> Meshes;
 
@@ -79,9 +201,28 @@ namespace mgl {
 #endif
         std::vector<unsigned int> Indices;
 
+        // Meshlets [index ranges with model space bounds, kept after upload]
+        std::vector<Meshlet> Meshlets;
+
+        // Levels of Detail [coarsest last]
+        std::vector<MeshLod> Lods;
+
         void processScene(const aiScene* scene);
-        void processMesh(const aiMesh* mesh);
-        void createBufferObjects();
+        void processMesh(const aiMesh* mesh, const MeshData& data);
+        void releaseVertices();
+        void optimizeMeshes();
+        void createMeshlets();
+        void computeBounds();
+        template<class Function>
+        void withVertexFormat(bool compressed, Function f);
+        void packVertexData(std::vector<unsigned char>& vertices);
+        void createBufferObjects(const void* vertices, const unsigned int* indices,
+            size_t indexCount);
+        void reportCompression(const VertexSource& source);
+        std::string getCookedPath(const std::string& filename);
+        bool loadCooked(const std::string& path);
+        void saveCooked(const std::string& path,
+            const std::vector<unsigned char>& vertices);
         void destroyBufferObjects();
     };
 
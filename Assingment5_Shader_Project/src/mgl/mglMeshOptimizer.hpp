@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Mesh Optimization Functions
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MESH_OPTIMIZER_HPP
+#define MGL_MESH_OPTIMIZER_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mgl {
+
+    struct VertexCacheStats;
+
+    /////////////////////////////////////////////////////////////////// VERTEX CACHE
+
+    // Average cache miss ratio [misses per triangle, 0.5 is ideal for a
+    // regular grid, 3 the worst] and average transform to vertex ratio
+    // [misses per referenced vertex, 1 is ideal].
+    struct VertexCacheStats {
+        double acmr = 0.0;
+        double atvr = 0.0;
+    };
+
+    // Simulates a FIFO post-transform cache of cacheSize entries.
+    VertexCacheStats analyzeVertexCache(const unsigned int* indices,
+        std::size_t indexCount, std::size_t vertexCount, std::size_t cacheSize = 16);
+
+    // Tipsify [Sander, Nehab & Barczak 2007]: reorders triangles in place
+    // for a cache of cacheSize. clusters, if given, gets the first triangle
+    // of each run that starts after a cache flush, for optimizeOverdraw.
+    void optimizeVertexCache(unsigned int* indices, std::size_t indexCount,
+        std::size_t vertexCount, std::size_t cacheSize = 16,
+        std::vector<std::size_t>* clusters = nullptr);
+
+    /////////////////////////////////////////////////////////////////////// OVERDRAW
+
+    // Sorts the clusters from optimizeVertexCache so that the ones facing
+    // away from the mesh center, likely to occlude others, are drawn first.
+    // Triangle order inside a cluster, and so its cache behavior, is kept.
+    void optimizeOverdraw(unsigned int* indices, std::size_t indexCount,
+        const glm::vec3* positions, const std::vector<std::size_t>& clusters);
+
+    /////////////////////////////////////////////////////////////////// VERTEX FETCH
+
+    // Renumbers vertices in order of first use so fetches walk memory
+    // forward; unreferenced vertices go last. Returns remap[old] = new, to
+    // be applied to every vertex array with remapVertices.
+    std::vector<unsigned int> optimizeVertexFetch(unsigned int* indices,
+        std::size_t indexCount, std::size_t vertexCount);
+
+    template<class T>
+    void remapVertices(T* vertices, const std::vector<unsigned int>& remap) {
+        std::vector<T> copy(vertices, vertices + remap.size());
+        for (std::size_t i = 0; i < remap.size(); i++) {
+            vertices[remap[i]] = copy[i];
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_MESH_OPTIMIZER_HPP */
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Meshlet Functions
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_MESHLET_HPP
+#define MGL_MESHLET_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace mgl {
+
+    struct Meshlet;
+    struct DrawCommand;
+
+    //////////////////////////////////////////////////////////////////////// MESHLET
+
+    const size_t MESHLET_VERTICES = 64;
+    const size_t MESHLET_TRIANGLES = 124;
+
+    // A run of consecutive triangles of the index buffer touching at most
+    // MESHLET_VERTICES vertices. Bounds are in model space: a sphere, and
+    // a cone holding every triangle normal, so the whole cluster faces away
+    // from eyes inside the cone behind it [cutoff 1 never culls].
+    struct Meshlet {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+        glm::vec3 coneAxis = glm::vec3(0.0f);
+        float coneCutoff = 1.0f;
+        unsigned int firstIndex = 0;
+        unsigned int indexCount = 0;
+        unsigned int baseVertex = 0;
+        unsigned int padding = 0;
+    };
+
+    // Layout of glMultiDrawElementsIndirect commands.
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Splits triangles in their current order, so a cache-optimized order
+    // gives compact clusters. firstIndex is relative to indices.
+    void buildMeshlets(const unsigned int* indices, size_t indexCount,
+        const glm::vec3* positions, size_t vertexCount, std::vector<Meshlet>& out);
+
+    // Writes a command for every meshlet inside the frustum of
+    // modelViewProjection and not facing away from eye [model space].
+    // Offsets are added to every command. Returns the commands written.
+    size_t cullMeshlets(const Meshlet* meshlets, size_t count,
+        const glm::mat4& modelViewProjection, const glm::vec3& eye,
+        GLuint firstIndex, GLint baseVertex, DrawCommand* out);
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_MESHLET_HPP */
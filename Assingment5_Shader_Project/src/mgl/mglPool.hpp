@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Pool Allocator Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_POOL_HPP
+#define MGL_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace mgl {
+
+    /////////////////////////////////////////////////////////////////////////// POOL
+
+    // Fixed-size object pool. Memory is taken from the system in chunks of
+    // ChunkSize objects and never moves, so pointers stay valid until the
+    // object is destroyed. Destroyed slots go to a free list and are reused
+    // before a new chunk is allocated.
+    template<class T, std::size_t ChunkSize = 256>
+    class Pool {
+    private:
+        union Slot {
+            Slot* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        std::vector<std::unique_ptr<Slot[]>> chunks;
+        Slot* freeList = nullptr;
+        std::size_t live = 0;
+
+        void grow();
+
+    public:
+        Pool();
+        ~Pool();
+        Pool(Pool const&) = delete;
+        void operator=(Pool const&) = delete;
+
+        template<class... Args>
+        T* create(Args&&... args);
+        void destroy(T* object);
+        void release();
+
+        std::size_t size();
+        std::size_t capacity();
+    };
+
+    template<class T, std::size_t ChunkSize>
+    Pool<T, ChunkSize>::Pool() {}
+
+    // Objects still alive are not destructed; owners destroy them first.
+    template<class T, std::size_t ChunkSize>
+    Pool<T, ChunkSize>::~Pool() {}
+
+    template<class T, std::size_t ChunkSize>
+    void Pool<T, ChunkSize>::grow() {
+        Slot* chunk = new Slot[ChunkSize];
+        for (std::size_t i = 0; i < ChunkSize; i++) {
+            chunk[i].next = i + 1 < ChunkSize ? &chunk[i + 1] : freeList;
+        }
+        freeList = chunk;
+        chunks.emplace_back(chunk);
+    }
+
+    template<class T, std::size_t ChunkSize>
+    template<class... Args>
+    T* Pool<T, ChunkSize>::create(Args&&... args) {
+        if (!freeList) grow();
+        Slot* slot = freeList;
+        freeList = slot->next;
+        live++;
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    template<class T, std::size_t ChunkSize>
+    void Pool<T, ChunkSize>::destroy(T* object) {
+        object->~T();
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = freeList;
+        freeList = slot;
+        live--;
+    }
+
+    // Returns every chunk to the system; all objects must be destroyed.
+    template<class T, std::size_t ChunkSize>
+    void Pool<T, ChunkSize>::release() {
+        chunks.clear();
+        freeList = nullptr;
+        live = 0;
+    }
+
+    template<class T, std::size_t ChunkSize>
+    std::size_t Pool<T, ChunkSize>::size() {
+        return live;
+    }
+
+    template<class T, std::size_t ChunkSize>
+    std::size_t Pool<T, ChunkSize>::capacity() {
+        return chunks.size() * ChunkSize;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_POOL_HPP */
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Frame Profiler
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_PROFILER_HPP
+#define MGL_PROFILER_HPP
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mgl {
+
+    class Profiler;
+
+    /////////////////////////////////////////////////////////////////////// PROFILER
+
+    // CPU scopes are timed with RDTSC (MGL_PROFILE_RDTSC) or steady_clock and
+    // stored in a ring buffer owned by the recording thread. GPU scopes use
+    // GL_TIMESTAMP query pairs that are read back GPU_LATENCY frames later,
+    // and only if already available, so the pipeline never stalls.
+    class Profiler {
+    public:
+        static const size_t RING_SIZE = 1 << 16;
+        static const unsigned int GPU_LATENCY = 4;
+        static const unsigned int GPU_QUERIES = 512;
+
+        struct Sample {
+            const char* name;
+            uint64_t start, end;
+            uint32_t frame;
+        };
+
+        static Profiler& getInstance();
+        ~Profiler();
+
+        static uint64_t now();
+        void beginFrame();
+        uint32_t getFrame();
+        void record(const char* name, uint64_t start, uint64_t end);
+        int beginGpu(const char* name);
+        void endGpu(int query);
+        void dump(const std::string& filename, uint32_t first, uint32_t last);
+
+    private:
+        Profiler();
+
+        // Single writer (the owning thread), any number of readers. Each
+        // slot is a seqlock: its sequence is odd while written and 2 * (i + 1)
+        // once it holds entry i, so readers drop the entries being written
+        // or overwritten while they copy them.
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+            std::atomic<const char*> name;
+            std::atomic<uint64_t> start, end;
+            std::atomic<uint32_t> frame;
+        };
+        struct Ring {
+            std::unique_ptr<Slot[]> slots;
+            std::atomic<uint64_t> head;
+            uint32_t threadId;
+            Ring(uint32_t tid);
+            void push(const Sample& sample);
+            void copy(std::vector<Sample>& out);
+        };
+        std::mutex ringsMutex;
+        std::vector<std::unique_ptr<Ring>> rings;
+        Ring* getRing();
+
+        std::atomic<uint32_t> frame;
+        double ticksPerMicrosecond;
+
+        // GPU [one set of query pairs per in-flight frame]
+        struct GpuFrame {
+            std::vector<GLuint> queries;
+            std::vector<const char*> names;
+            uint32_t frame = 0;
+            unsigned int count = 0;
+        };
+        GpuFrame gpuFrames[GPU_LATENCY];
+        Ring* gpuRing;
+        int64_t gpuBase;
+        uint64_t cpuBase;
+        void setupGpu();
+        void collectGpu(GpuFrame& gpu);
+    };
+
+    ////////////////////////////////////////////////////////////////////// SCOPES
+
+    class ProfileScope {
+    public:
+        explicit ProfileScope(const char* name)
+            : name(name), start(Profiler::now()) {}
+        ~ProfileScope() { Profiler::getInstance().record(name, start, Profiler::now()); }
+
+    private:
+        const char* name;
+        uint64_t start;
+    };
+
+    class GpuProfileScope {
+    public:
+        explicit GpuProfileScope(const char* name)
+            : query(Profiler::getInstance().beginGpu(name)) {}
+        ~GpuProfileScope() { Profiler::getInstance().endGpu(query); }
+
+    private:
+        int query;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+///////////////////////////////////////////////////////////////////////// Macros
+
+#define MGL_PROFILE_CONCAT_(a, b) a##b
+#define MGL_PROFILE_CONCAT(a, b) MGL_PROFILE_CONCAT_(a, b)
+
+#ifdef MGL_PROFILE
+#define MGL_PROFILE_FRAME mgl::Profiler::getInstance().beginFrame();
+#define MGL_PROFILE_SCOPE(name) \
+    mgl::ProfileScope MGL_PROFILE_CONCAT(profileScope, __LINE__)(name);
+#define MGL_PROFILE_GPU_SCOPE(name) \
+    mgl::GpuProfileScope MGL_PROFILE_CONCAT(gpuProfileScope, __LINE__)(name);
+#else
+#define MGL_PROFILE_FRAME
+#define MGL_PROFILE_SCOPE(name)
+#define MGL_PROFILE_GPU_SCOPE(name)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+#endif /* MGL_PROFILER_HPP */
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Transient GPU Ring Buffer Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_RING_BUFFER_HPP
+#define MGL_RING_BUFFER_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace mgl {
+
+    class RingBuffer;
+
+    //////////////////////////////////////////////////////////////////// RING BUFFER
+
+    // Frame-scoped uniform data. One buffer, mapped once and kept mapped,
+    // is split into three regions; a frame writes into its region and
+    // fences it at the end, and a region is only reused once its fence has
+    // passed. A frame that fills its region moves on to the next one, so
+    // the memory stays bounded and only a frame larger than two regions can
+    // wait on the GPU. Allocations live until the end of the frame and need
+    // the GL context.
+    class RingBuffer {
+    public:
+        struct Allocation {
+            void* data = nullptr;
+            GLuint buffer = 0;
+            GLintptr offset = 0;
+            GLsizeiptr size = 0;
+        };
+
+        static RingBuffer& getInstance();
+
+        void create(GLsizeiptr regionsize);
+        void destroy();
+        void beginFrame();
+        void endFrame();
+        Allocation allocate(GLsizeiptr size);
+        void bind(GLuint bindingpoint, const Allocation& allocation);
+        void bindBuffer(GLenum target, const Allocation& allocation);
+
+        GLsizeiptr getRegionSize();
+        size_t getStalls();
+
+    private:
+        static const int REGIONS = 3;
+
+        RingBuffer();
+        ~RingBuffer();
+        GLuint BufferId;
+        unsigned char* Mapped;
+        // without persistent mapping (before GL 4.4) data is staged on the
+        // CPU and sent with glBufferSubData when bound
+        bool Persistent;
+        std::vector<unsigned char> Staging;
+        GLsizeiptr RegionSize, Head;
+        GLint Alignment;
+        int Current;
+        GLsync Fences[REGIONS];
+        size_t Stalls;
+
+        void flush(const Allocation& allocation);
+        void advance();
+        void fence();
+        void wait(int region);
+
+    public:
+        RingBuffer(RingBuffer const&) = delete;
+        void operator=(RingBuffer const&) = delete;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_RING_BUFFER_HPP */
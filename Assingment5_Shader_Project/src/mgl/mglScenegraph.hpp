@@ -17,20 +17,38 @@
 #include <fstream>
 
 #include "mglOrbitCamera.hpp"
+#include "mglPool.hpp"
+#include "mglTransform.hpp"
 
 namespace mgl {
 
+	class GpuScene;
 	class IDrawable;
+	class Mesh;
 	class Scenegraph;
 	class SceneNode;
+	class ShaderProgram;
+	class StaticBatch;
+	struct FrameConstants;
+	struct SceneSnapshot;
 
 	////////////////////////////////////////////////////////////////////// IDrawable
 
 	class IDrawable {
 	public:
+		virtual ~IDrawable() {}
 		virtual void draw(void) = 0;
 	};
 
+	///////////////////////////////////////////////////////////////////// NodeHandle
+
+	// Stays valid while the node lives; a handle to a removed node resolves
+	// to null even after its slot is reused.
+	struct NodeHandle {
+		unsigned int slot = 0xFFFFFFFF;
+		unsigned int generation = 0;
+	};
+
 	///////////////////////////////////////////////////////////////////// Scenegraph
 
 	enum Mode {
@@ -58,12 +76,47 @@ namespace mgl {
 
 		Mode mode = Mode::NONE;
 
-		int nodeID = 0;
+		NodeHandle selected;
 
 		bool leftClick;
 		double xprev, yprev;
 
+		// Nodes [dense, in draw order]
 		std::vector<SceneNode*> nodes;
+		Pool<SceneNode> nodePool;
+
+		// Handles [slot -> node index]
+		struct HandleSlot {
+			int index = -1;
+			unsigned int generation = 0;
+		};
+		std::vector<HandleSlot> handles;
+		std::vector<unsigned int> freeHandles;
+
+		// Transforms [indexed by node index]
+		std::vector<glm::vec3> translations;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<glm::mat3> normalMatrices;
+
+		// Culling [indices of nodes inside the view frustum]
+		std::vector<int> visibleNodes;
+
+		// Constants of the frame being submitted
+		FrameConstants* frame = nullptr;
+
+		// GPU-Driven [nodes changed since the last frame]
+		GpuScene* gpuScene = nullptr;
+		std::vector<int> changedNodes;
+		std::vector<char> changed;
+
+		// Static Batching [static nodes baked into world space chunks]
+		StaticBatch* staticBatch = nullptr;
+
+		void updateTransforms();
+		void syncGpuScene();
+		NodeHandle pickSphere(double xpos, double ypos, bool staticOnly = false);
 
 	public:
 		Scenegraph(std::string path);
@@ -77,14 +130,32 @@ namespace mgl {
 		void setCameraPerspective(float fovy, float aspect, float near, float far);
 		void setLight(glm::vec3 light);
 		glm::vec3 getLight();
-		void addNode(SceneNode* node);
+		SceneNode* createNode();
+		SceneNode* getNode(NodeHandle handle);
+		bool removeNode(NodeHandle handle);
+		void clear();
+		size_t getNodeCount();
+		const glm::mat4& getWorldMatrix(int index);
+		const glm::mat3& getNormalMatrix(int index);
+		FrameConstants& getFrameConstants();
+		bool setGpuDriven(ShaderProgram* culling);
+		bool isGpuDriven();
+		void setStaticBatching(ShaderProgram* shader, float chunkSize = 16.0f);
+		bool isStaticBatching();
+		void markChanged(int index);
 
 		void save();
 		bool load();
 
 		void pick(GLFWwindow* win, int button, int action);
+		void select(NodeHandle handle);
 
+		void update();
+		void cull();
+		void submit();
 		void draw();
+		void snapshot(SceneSnapshot& out);
+		size_t getVisibleCount();
 
 		void windowSizeCallback(GLFWwindow* win, int width, int height);
 		void keyCallback(GLFWwindow* win, int key, int scancode, int action, int mods);
@@ -99,8 +170,11 @@ namespace mgl {
 	private:
 		Scenegraph* root = nullptr;
 		int index;
+		NodeHandle handle;
 		// Model Matrix [Scale, Rotate, Translate]
-		glm::mat4 modelMatrix[3];
+		glm::vec3 scaling = glm::vec3(1.0f);
+		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 translation = glm::vec3(0.0f);
 		// Scale
 		const float scaleStep = 1.1f;
 		// Rotate
@@ -111,19 +185,37 @@ namespace mgl {
 		glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f);
 		std::string meshID;
 		std::string shaderID;
+		Mesh* mesh = nullptr;
+		ShaderProgram* shader = nullptr;
+		// Static [baked into a chunk when the scenegraph batches]
+		bool staticFlag = false;
 		// texture
 		// callbacks
 
+		void changed();
+
 	public:
 		SceneNode();
 		~SceneNode();
 		void setRoot(Scenegraph* root);
 		void setIndex(int index);
+		void setHandle(NodeHandle handle);
+		NodeHandle getHandle();
 		void setModelMatrix(glm::mat4 scale, glm::mat4 rotate, glm::mat4 translate);
 		void updateModelMatrix(glm::mat4 scale, glm::mat4 rotate, glm::mat4 translate);
+		void setTransform(glm::vec3 scaling, glm::quat rotation, glm::vec3 translation);
+		const glm::vec3& getScaling();
+		const glm::quat& getRotation();
+		const glm::vec3& getTranslation();
 		void setColor(glm::vec3 color);
+		const glm::vec3& getColor();
 		void setMesh(std::string meshID);
 		void setShader(std::string shaderID);
+		const std::string& getShaderID();
+		Mesh* getMesh();
+		ShaderProgram* getShader();
+		void setStatic(bool staticFlag);
+		bool isStatic();
 
 		void save(std::ofstream& file);
 		void load(std::ifstream& file);
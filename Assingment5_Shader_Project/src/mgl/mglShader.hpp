@@ -3,6 +3,8 @@
 // Shader Program Class
 //
 // Copyright (c)2022-23 by Carlos Martinho
+// 
+// modified by Joo Baracho
 //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -11,16 +13,64 @@
 
 #include <GL/glew.h>
 
+#include <cstdint>
+#include <initializer_list>
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
 
 namespace mgl {
 
     class ShaderProgram;
+    struct UniformValue;
 
     ////////////////////////////////////////////////////////////////// ShaderProgram
 
+    // Programs looked up in a binary cache, over every program so far.
+    // Stale entries were found but rejected, and count as misses too.
+    struct ShaderCacheStats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t stale = 0;
+        double compileSeconds = 0.0;
+        double savedSeconds = 0.0;
+    };
+
+    // A typed value for setUniforms() and writeBlock(), of count array
+    // elements. It only points at the data, which must outlive the call.
+    struct UniformValue {
+        const char* name;
+        GLenum type;
+        GLsizei count;
+        const void* data;
+
+        UniformValue(const char* name, const GLfloat& value, GLsizei count = 1);
+        UniformValue(const char* name, const GLint& value, GLsizei count = 1);
+        UniformValue(const char* name, const GLuint& value, GLsizei count = 1);
+        UniformValue(const char* name, const glm::vec2& value, GLsizei count = 1);
+        UniformValue(const char* name, const glm::vec3& value, GLsizei count = 1);
+        UniformValue(const char* name, const glm::vec4& value, GLsizei count = 1);
+        UniformValue(const char* name, const glm::mat3& value, GLsizei count = 1);
+        UniformValue(const char* name, const glm::mat4& value, GLsizei count = 1);
+    };
+
+    // Shaders are compiled by create(), unless a program binary cached by
+    // a previous run for the same sources, attribute bindings and driver
+    // can be loaded instead [see setCacheDirectory()]. reload() builds the
+    // program again from its files next to the live one, which
+    // pollReload() replaces only once the new one has linked. Sources are
+    // read with their #include files and the defines given by addDefine().
+    // A program made of stages [see addStage()] is a pipeline of separable
+    // programs instead of one of its own.
+    //
+    // Every program that goes live is reflected: its active uniforms,
+    // buffer variables and blocks are listed, sorted by name, with their
+    // types and the offsets and strides of block members. Names given by
+    // addUniform() and addUniformBlock() are looked up there, and warned
+    // about when missing; the others are still found by setUniforms().
     class ShaderProgram {
     public:
         GLuint ProgramId;
@@ -46,24 +96,103 @@ namespace mgl {
         };
         std::map<std::string, UboInfo> Ubos;
 
+        // Reflection [active resources, sorted by name, then block]
+        struct VariableInfo {
+            std::string name;
+            GLenum type;
+            GLint arraySize;
+            GLint location;     // -1 inside a block
+            GLint block;        // into getBlocks(), -1 outside any
+            GLint offset;       // of block members, as laid out by the GL
+            GLint arrayStride;
+            GLint matrixStride;
+            GLuint program;     // that has it, a stage of a pipeline
+        };
+        struct BlockInfo {
+            std::string name;
+            GLenum interface;   // GL_UNIFORM_BLOCK or GL_SHADER_STORAGE_BLOCK
+            GLuint index;
+            GLint binding;
+            GLint dataSize;
+        };
+
         ShaderProgram();
         ~ShaderProgram();
         void addShader(const GLenum shader_type, const std::string& filename);
+        void addDefine(const std::string& name, const std::string& value = "");
+        void addStage(const GLbitfield stages, ShaderProgram* program);
+        void setSeparable(const bool separable);
         void addAttribute(const std::string& name, const GLuint index);
         bool isAttribute(const std::string& name);
         void addUniform(const std::string& name);
         bool isUniform(const std::string& name);
         void addUniformBlock(const std::string& name, const GLuint binding_point);
         bool isUniformBlock(const std::string& name);
+        const std::vector<VariableInfo>& getVariables();
+        const std::vector<BlockInfo>& getBlocks();
+        const VariableInfo* findVariable(const std::string& name, GLint block = -1);
+        const BlockInfo* findBlock(const std::string& name);
+        bool setUniforms(std::initializer_list<UniformValue> values);
+        bool writeBlock(const std::string& name, void* data, size_t size,
+            std::initializer_list<UniformValue> values);
+        void setCacheDirectory(const std::string& directory);
         void create();
+        void reload();
+        bool pollReload();
+        std::vector<std::string> getFilenames();
         void bind();
         void unbind();
 
+        static ShaderCacheStats getCacheStats();
+        static void printCacheStats();
+
     private:
-        const std::string read(const std::string& filename);
-        const GLuint checkCompilation(const GLuint shader_id,
-            const std::string& filename);
-        void checkLinkage();
+        struct SourceInfo {
+            std::string filename;
+            std::string code;
+            // the file, then the ones it included [numbered as in #line]
+            std::vector<std::string> files;
+        };
+        std::map<GLenum, SourceInfo> Sources;
+        std::map<std::string, std::string> Defines;
+        std::string CacheDirectory;
+        bool Separable;
+
+        // Pipeline [separable programs bound per stage, 0 if none]
+        struct StageInfo {
+            GLbitfield stages;
+            ShaderProgram* program;
+            GLuint attached;
+        };
+        GLuint PipelineId;
+        std::vector<StageInfo> Stages;
+
+        std::vector<VariableInfo> Variables;
+        std::vector<BlockInfo> Blocks;
+
+        // Reload [program being built, 0 if none]
+        GLuint PendingId;
+        std::map<GLenum, GLuint> PendingShaders;
+
+        static ShaderCacheStats CacheStats;
+
+        const std::string read(const std::string& filename,
+            std::vector<std::string>& files);
+        void preprocess();
+        bool checkCompilation(const GLuint shader_id, const SourceInfo& source);
+        bool checkLinkage(const GLuint program_id);
+        void compile();
+        void locateUniforms();
+        void reflect();
+        void reflectResources();
+        void reflectActive();
+        void sortReflection();
+        void attachStages();
+        void discardReload();
+        std::uint64_t getCacheKey();
+        std::string getCachePath(std::uint64_t key);
+        bool loadBinary(const std::string& path, std::uint64_t key);
+        void saveBinary(const std::string& path, std::uint64_t key, double seconds);
     };
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Shader Variants Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_SHADER_VARIANTS_HPP
+#define MGL_SHADER_VARIANTS_HPP
+
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./mglShader.hpp"
+
+namespace mgl {
+
+    class ShaderVariants;
+
+    ///////////////////////////////////////////////////////////////// SHADER FEATURE
+
+    // What a variant is built for, one bit each; a variant has the define
+    // of every feature it was built for [see mglConventions.hpp].
+    enum ShaderFeature {
+        NORMALS = 1 << 0,
+        TEXCOORDS = 1 << 1,
+        TANGENTS = 1 << 2,
+        COMPRESSED = 1 << 3,
+        VERTEX_COLORS = 1 << 4,
+        INSTANCING = 1 << 5,
+        SKINNING = 1 << 6,
+        ALL_FEATURES = (1 << 7) - 1
+    };
+
+    //////////////////////////////////////////////////////////////// SHADER VARIANTS
+
+    // One program per set of features, from the same files, which #ifdef
+    // what differs. get() builds a variant the first time it is asked for,
+    // on the context thread, and keeps it; the new programs go into the
+    // ShaderManager as "name:features", so they are reloaded like others.
+    //
+    // A stage depends only on the features given with it, which the other
+    // bits of a key do not split. Separable variants build each stage once
+    // per its own features and pair them in a pipeline, so N vertex and M
+    // fragment variants cost N + M compiles instead of N * M. Their stages
+    // must match by name and type, and redeclare gl_PerVertex where the
+    // driver asks for it; without separate shader objects, variants are
+    // linked programs.
+    class ShaderVariants {
+    public:
+        ShaderVariants(const std::string& name);
+        const std::string& getName();
+        void addShader(const GLenum shader_type, const std::string& filename,
+            const unsigned int features = ALL_FEATURES);
+        void addAttribute(const std::string& name, const GLuint index);
+        void addUniform(const std::string& name);
+        void addUniformBlock(const std::string& name, const GLuint binding_point);
+        void addDefine(const std::string& name, const std::string& value = "");
+        void setCacheDirectory(const std::string& directory);
+        void setSeparable(const bool separable);
+        ShaderProgram* get(unsigned int features);
+        size_t getCount();
+
+    private:
+        struct StageInfo {
+            GLenum type;
+            std::string filename;
+            unsigned int features;
+        };
+        std::string Name;
+        std::vector<StageInfo> Stages;
+        std::map<std::string, GLuint> Attributes;
+        std::vector<std::string> Uniforms;
+        std::map<std::string, GLuint> Ubos;
+        std::map<std::string, std::string> Defines;
+        std::string CacheDirectory;
+        bool Separable;
+
+        // Variants [features -> program or pipeline]
+        std::map<unsigned int, ShaderProgram*> Variants;
+        // Separable [type and features of a stage -> its program]
+        std::map<std::pair<GLenum, unsigned int>, ShaderProgram*> StagePrograms;
+
+        unsigned int getMask();
+        ShaderProgram* getStage(const StageInfo& stage, unsigned int features);
+        void configure(ShaderProgram* program, unsigned int features);
+        std::string getKey(const std::string& prefix, unsigned int features);
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_SHADER_VARIANTS_HPP */
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Scene Snapshot Classes
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_SNAPSHOT_HPP
+#define MGL_SNAPSHOT_HPP
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "./mglRingBuffer.hpp"
+#include "./mglScenegraph.hpp"
+#include "./mglSpscQueue.hpp"
+
+namespace mgl {
+
+    class Mesh;
+    class ShaderProgram;
+    class SnapshotRenderer;
+
+    /////////////////////////////////////////////////////////////////////// SNAPSHOT
+
+    // Everything needed to draw one node, copied out of the scenegraph so it
+    // can be drawn while the scenegraph keeps changing. Meshes live in their
+    // manager and outlive any snapshot. The shader is kept as the key and
+    // mesh features it is looked up with, since a variant not built yet can
+    // only be built on the GL context thread.
+    struct DrawItem {
+        Mesh* mesh = nullptr;
+        std::string shaderKey;
+        unsigned int shaderFeatures = 0;
+        glm::mat4 world;
+        glm::mat3 normal;
+        glm::vec3 color;
+        NodeHandle handle;
+    };
+
+    struct SceneSnapshot {
+        glm::mat4 view;
+        glm::mat4 projection;
+        GLuint bindingPoint = 0;
+        glm::vec3 eye;
+        glm::vec3 light;
+        std::vector<DrawItem> items;
+    };
+
+    // Constants shared by every item of a frame. The Frame block is written
+    // into the ring buffer by the first item whose shader uses it; the
+    // view-projection is for meshes culling their meshlets.
+    struct FrameConstants {
+        glm::vec3 light;
+        glm::vec3 eye;
+        glm::mat4 viewProjection;
+        RingBuffer::Allocation block;
+    };
+
+    // Draws one item with shader, writing stencil into the stencil buffer
+    // for picking. Shaders with Frame/Object blocks get their constants
+    // through the ring buffer, others through plain uniforms.
+    void drawItem(const DrawItem& item, ShaderProgram* shader, FrameConstants& frame,
+        GLint stencil);
+
+    // Gives shader the Frame block, or the light and eye uniforms.
+    void bindFrameConstants(ShaderProgram* shader, FrameConstants& frame);
+
+    ////////////////////////////////////////////////////////////// SNAPSHOT RENDERER
+
+    // Render thread side of a threaded app: draws snapshots and answers
+    // pick requests against the last snapshot drawn. Picked handles go back
+    // to the main thread through pollPick().
+    class SnapshotRenderer {
+    public:
+        SnapshotRenderer();
+        SnapshotRenderer(SnapshotRenderer const&) = delete;
+        void operator=(SnapshotRenderer const&) = delete;
+
+        void draw(const SceneSnapshot& snapshot);
+        void pick(int x, int y);
+        bool pollPick(NodeHandle& handle);
+
+    private:
+        const SceneSnapshot* last;
+        SpscQueue<NodeHandle, 16> picked;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_SNAPSHOT_HPP */
@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Single-Producer Single-Consumer Queue Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_SPSC_QUEUE_HPP
+#define MGL_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace mgl {
+
+    ///////////////////////////////////////////////////////////////////// SPSC QUEUE
+
+    // Bounded lock-free ring for handing values from exactly one thread to
+    // exactly one other. push() fails when full and pop() when empty; neither
+    // ever blocks. Capacity must be a power of two.
+    template<class T, std::size_t Capacity>
+    class SpscQueue {
+    private:
+        static_assert((Capacity & (Capacity - 1)) == 0,
+            "SpscQueue capacity must be a power of two");
+
+        T items[Capacity];
+        // head is written by the consumer and tail by the producer only;
+        // padded onto separate cache lines so they do not bounce between
+        // cores (padding rather than alignas, which plain new may not honor)
+        char headPadding[64];
+        std::atomic<std::size_t> head;
+        char tailPadding[64];
+        std::atomic<std::size_t> tail;
+
+    public:
+        SpscQueue();
+        SpscQueue(SpscQueue const&) = delete;
+        void operator=(SpscQueue const&) = delete;
+
+        bool push(const T& item);
+        bool pop(T& item);
+        bool empty();
+    };
+
+    template<class T, std::size_t Capacity>
+    SpscQueue<T, Capacity>::SpscQueue() : head(0), tail(0) {}
+
+    // Producer thread only.
+    template<class T, std::size_t Capacity>
+    bool SpscQueue<T, Capacity>::push(const T& item) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+        items[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only.
+    template<class T, std::size_t Capacity>
+    bool SpscQueue<T, Capacity>::pop(T& item) {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    template<class T, std::size_t Capacity>
+    bool SpscQueue<T, Capacity>::empty() {
+        return head.load(std::memory_order_acquire) ==
+            tail.load(std::memory_order_acquire);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_SPSC_QUEUE_HPP */
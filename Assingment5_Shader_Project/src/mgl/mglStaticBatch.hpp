@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Static Batch Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_STATIC_BATCH_HPP
+#define MGL_STATIC_BATCH_HPP
+
+#include <GL/glew.h>
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "./mglScenegraph.hpp"
+
+namespace mgl {
+
+    class StaticBatch;
+    class ShaderProgram;
+    struct FrameConstants;
+    struct GeometryAllocation;
+
+    /////////////////////////////////////////////////////////////////// STATIC BATCH
+
+    // Static nodes baked into world space. Nodes are grouped by the cell
+    // of a grid of chunkSize their translation falls in; each cell keeps
+    // one merged range of position, normal and color vertices in the
+    // geometry pool and draws with a single call after a frustum test of
+    // its bounds. Placing or removing a node only marks its cells, which
+    // rebuild() bakes again before the next frame.
+    //
+    // Every chunk draws with the batch shader, whatever the nodes' own, and
+    // with stencil 0. Meshes of static nodes must keep their arrays
+    // [VertexRetention::KEEP]. Needs the GL context.
+    class StaticBatch {
+    public:
+        StaticBatch(ShaderProgram* shader, float chunkSize);
+        ~StaticBatch();
+        StaticBatch(StaticBatch const&) = delete;
+        void operator=(StaticBatch const&) = delete;
+
+        void place(SceneNode* node);
+        void remove(NodeHandle handle);
+        void clear();
+        void rebuild(Scenegraph* scenegraph);
+        void draw(const glm::mat4& viewProjection, FrameConstants& frame);
+
+        size_t getChunkCount();
+        size_t getNodeCount();
+
+    private:
+        typedef std::tuple<int, int, int> ChunkKey;
+
+        struct Chunk {
+            std::vector<NodeHandle> nodes;
+            GeometryAllocation* geometry = nullptr;
+            glm::vec3 center;
+            float radius = 0.0f;
+        };
+
+        ShaderProgram* Shader;
+        float ChunkSize;
+        std::map<ChunkKey, Chunk> Chunks;
+        // Placement [node handle slot -> chunk]
+        std::map<unsigned int, ChunkKey> Placement;
+        std::set<ChunkKey> Dirty;
+
+        void bake(Scenegraph* scenegraph, Chunk& chunk);
+    };
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_STATIC_BATCH_HPP */
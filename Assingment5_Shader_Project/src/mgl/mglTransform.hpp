@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Batched Transform Composition
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_TRANSFORM_HPP
+#define MGL_TRANSFORM_HPP
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////////// SIMD PATH
+
+    enum SimdPath {
+        SCALAR,
+        SSE4,
+        AVX2
+    };
+
+    // The best path the cpu runs, up to SSE4; setSimdPath() can pick AVX2,
+    // and never picks a path the cpu can not run.
+    SimdPath getSimdPath();
+    void setSimdPath(SimdPath path);
+    const char* getSimdPathName(SimdPath path);
+
+    ///////////////////////////////////////////////////////////////////// TRANSFORMS
+
+    // Writes world = T * R * S and normal = transpose(inverse(mat3(world)))
+    // for count nodes. normals may be null. All paths give the same world
+    // matrices as composing the glm matrices; normal matrices are computed
+    // as R * inverse(S) and agree with glm within float tolerance.
+    void composeTransforms(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals);
+
+    void composeTransformsScalar(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals);
+    void composeTransformsSSE4(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals);
+    void composeTransformsAVX2(std::size_t count, const glm::vec3* translations,
+        const glm::quat* rotations, const glm::vec3* scales, glm::mat4* worlds,
+        glm::mat3* normals);
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_TRANSFORM_HPP */
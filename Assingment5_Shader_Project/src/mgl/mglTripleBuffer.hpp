@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Triple Buffer Class
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_TRIPLE_BUFFER_HPP
+#define MGL_TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+namespace mgl {
+
+    ////////////////////////////////////////////////////////////////// TRIPLE BUFFER
+
+    // Lock-free hand-over of whole values from one writer thread to one
+    // reader thread. The writer fills write() and publishes it; the reader
+    // always gets the latest published value and keeps it untouched until
+    // its next read(). Neither side ever waits for the other: values the
+    // reader was too slow to see are simply overwritten.
+    template<class T>
+    class TripleBuffer {
+    private:
+        // set on the shared index while it holds a value not yet read
+        static const unsigned int FRESH = 4;
+
+        T buffers[3];
+        unsigned int back = 0;        // writer's buffer
+        std::atomic<unsigned int> middle;
+        unsigned int front = 2;       // reader's buffer
+        bool received = false;
+
+    public:
+        TripleBuffer();
+        TripleBuffer(TripleBuffer const&) = delete;
+        void operator=(TripleBuffer const&) = delete;
+
+        T& write();
+        void publish();
+        const T* read();
+    };
+
+    template<class T>
+    TripleBuffer<T>::TripleBuffer() : middle(1) {}
+
+    // Writer thread only.
+    template<class T>
+    T& TripleBuffer<T>::write() {
+        return buffers[back];
+    }
+
+    // Writer thread only; the buffer returned by write() changes.
+    template<class T>
+    void TripleBuffer<T>::publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    // Reader thread only; null until the first publish().
+    template<class T>
+    const T* TripleBuffer<T>::read() {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+            front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+            received = true;
+        }
+        return received ? &buffers[front] : nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_TRIPLE_BUFFER_HPP */
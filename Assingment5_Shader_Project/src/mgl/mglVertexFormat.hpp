@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Vertex Format Descriptors
+//
+// by Joo Baracho
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MGL_VERTEX_FORMAT_HPP
+#define MGL_VERTEX_FORMAT_HPP
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/packing.hpp>
+
+namespace mgl {
+
+    struct VertexSource;
+
+    ////////////////////////////////////////////////////////////////// VERTEX SOURCE
+
+    // Separate per-vertex arrays, as loaded; the ones a format does not use
+    // may be null. Quantized positions are stored relative to the box
+    // [boundsMin, boundsMin + boundsExtent].
+    struct VertexSource {
+        const glm::vec3* positions = nullptr;
+        const glm::vec3* normals = nullptr;
+        const glm::vec2* texcoords = nullptr;
+        const glm::vec3* tangents = nullptr;
+        const glm::vec3* bitangents = nullptr;
+        const glm::vec3* colors = nullptr;
+        glm::vec3 boundsMin = glm::vec3(0.0f);
+        glm::vec3 boundsExtent = glm::vec3(1.0f);
+    };
+
+    /////////////////////////////////////////////////////////////////// OCTAHEDRAL
+
+    // Unit vector to a point in [-1, 1]^2: projected onto the octahedron
+    // |x| + |y| + |z| = 1, with the lower half folded over the diagonals.
+    inline glm::vec2 encodeOctahedral(glm::vec3 n) {
+        n /= glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+        glm::vec2 e(n.x, n.y);
+        if (n.z < 0.0f) {
+            glm::vec2 sign(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+            e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * sign;
+        }
+        return e;
+    }
+
+    inline glm::vec3 decodeOctahedral(glm::vec2 e) {
+        glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+        float t = glm::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    /////////////////////////////////////////////////////////////// VERTEX ATTRIBUTE
+
+    // An attribute describes how it is stored [components, type,
+    // normalization, size in bytes] and packs itself from a VertexSource.
+    // Any type with the same static members can be used in a VertexFormat.
+
+    // Floats copied unchanged from the source array Member.
+    template<GLuint Location, class T, const T* VertexSource::*Member>
+    struct FloatAttribute {
+        static constexpr GLuint location() { return Location; }
+        static constexpr GLint components() { return sizeof(T) / sizeof(float); }
+        static constexpr GLenum type() { return GL_FLOAT; }
+        static constexpr GLboolean normalized() { return GL_FALSE; }
+        static constexpr std::size_t size() { return sizeof(T); }
+
+        static void pack(const VertexSource& source, std::size_t i,
+            unsigned char* out) {
+            std::memcpy(out, &(source.*Member)[i], sizeof(T));
+        }
+    };
+
+    // Positions as unorm16 inside the VertexSource box. The shader sees
+    // [0, 1]^3; the box has to be put back by the model matrix.
+    template<GLuint Location>
+    struct QuantizedPositionAttribute {
+        static constexpr GLuint location() { return Location; }
+        static constexpr GLint components() { return 3; }
+        static constexpr GLenum type() { return GL_UNSIGNED_SHORT; }
+        static constexpr GLboolean normalized() { return GL_TRUE; }
+        static constexpr std::size_t size() { return 8; }
+
+        static void pack(const VertexSource& source, std::size_t i,
+            unsigned char* out) {
+            glm::vec3 q = (source.positions[i] - source.boundsMin) / source.boundsExtent;
+            glm::uint64 packed = glm::packUnorm4x16(glm::vec4(q, 0.0f));
+            std::memcpy(out, &packed, sizeof(packed));
+        }
+    };
+
+    // Unit vectors octahedral-encoded into x and y of a 2_10_10_10 snorm.
+    template<GLuint Location, const glm::vec3* VertexSource::*Member>
+    struct OctahedralAttribute {
+        static constexpr GLuint location() { return Location; }
+        static constexpr GLint components() { return 4; }
+        static constexpr GLenum type() { return GL_INT_2_10_10_10_REV; }
+        static constexpr GLboolean normalized() { return GL_TRUE; }
+        static constexpr std::size_t size() { return 4; }
+
+        static void pack(const VertexSource& source, std::size_t i,
+            unsigned char* out) {
+            glm::vec2 e = encodeOctahedral((source.*Member)[i]);
+            glm::uint32 packed = glm::packSnorm3x10_1x2(glm::vec4(e, 0.0f, 0.0f));
+            std::memcpy(out, &packed, sizeof(packed));
+        }
+    };
+
+    // Tangents encoded like OctahedralAttribute, with the handedness of the
+    // bitangent in w so the shader can rebuild it as cross(N, T) * w.
+    template<GLuint Location>
+    struct OctahedralTangentAttribute {
+        static constexpr GLuint location() { return Location; }
+        static constexpr GLint components() { return 4; }
+        static constexpr GLenum type() { return GL_INT_2_10_10_10_REV; }
+        static constexpr GLboolean normalized() { return GL_TRUE; }
+        static constexpr std::size_t size() { return 4; }
+
+        static void pack(const VertexSource& source, std::size_t i,
+            unsigned char* out) {
+            glm::vec3 n = source.normals[i], t = source.tangents[i];
+            float w = glm::dot(glm::cross(n, t), source.bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+            glm::vec2 e = encodeOctahedral(t);
+            glm::uint32 packed = glm::packSnorm3x10_1x2(glm::vec4(e, 0.0f, w));
+            std::memcpy(out, &packed, sizeof(packed));
+        }
+    };
+
+    // Pairs stored as two half floats.
+    template<GLuint Location, const glm::vec2* VertexSource::*Member>
+    struct HalfAttribute {
+        static constexpr GLuint location() { return Location; }
+        static constexpr GLint components() { return 2; }
+        static constexpr GLenum type() { return GL_HALF_FLOAT; }
+        static constexpr GLboolean normalized() { return GL_FALSE; }
+        static constexpr std::size_t size() { return 4; }
+
+        static void pack(const VertexSource& source, std::size_t i,
+            unsigned char* out) {
+            glm::uint packed = glm::packHalf2x16((source.*Member)[i]);
+            std::memcpy(out, &packed, sizeof(packed));
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////// VERTEX LAYOUT
+
+    // A vertex format as data: how to set up a VAO for it, its stride and,
+    // per attribute location, where and how the attribute is stored
+    // [0 components when the format has none]. Shaders that pull vertices
+    // from a storage buffer decode them with it.
+    struct VertexLayout {
+        static const GLuint MAX_ATTRIBUTES = 8;
+
+        struct Attribute {
+            GLuint offset = 0;
+            GLenum type = GL_FLOAT;
+            GLint components = 0;
+            GLboolean normalized = GL_FALSE;
+        };
+
+        void (*setup)(GLuint binding, GLuint offset) = nullptr;
+        GLsizei stride = 0;
+        Attribute attributes[MAX_ATTRIBUTES];
+    };
+
+    ////////////////////////////////////////////////////////////////// VERTEX FORMAT
+
+    // A list of attributes interleaved in order into a single vertex. The
+    // same list gives the CPU packing, the VAO layout and the VertexLayout,
+    // so they can not disagree.
+    template<class... Attributes>
+    struct VertexFormat;
+
+    template<>
+    struct VertexFormat<> {
+        static constexpr std::size_t stride() { return 0; }
+        static void pack(const VertexSource& /*source*/, std::size_t /*i*/,
+            unsigned char* /*out*/) {}
+        static void setup(GLuint /*binding*/, GLuint /*offset*/ = 0) {}
+        static void describe(VertexLayout& /*layout*/, GLuint /*offset*/ = 0) {}
+    };
+
+    template<class First, class... Rest>
+    struct VertexFormat<First, Rest...> {
+        static constexpr std::size_t stride() {
+            return First::size() + VertexFormat<Rest...>::stride();
+        }
+
+        // Writes vertex i at out.
+        static void pack(const VertexSource& source, std::size_t i,
+            unsigned char* out) {
+            First::pack(source, i, out);
+            VertexFormat<Rest...>::pack(source, i, out + First::size());
+        }
+
+        // Describes the attributes to the bound VAO; the buffer itself is
+        // attached with glBindVertexBuffer(binding, buffer, 0, stride()).
+        static void setup(GLuint binding, GLuint offset = 0) {
+            glEnableVertexAttribArray(First::location());
+            glVertexAttribFormat(First::location(), First::components(),
+                First::type(), First::normalized(), offset);
+            glVertexAttribBinding(First::location(), binding);
+            VertexFormat<Rest...>::setup(binding, offset + First::size());
+        }
+
+        static void describe(VertexLayout& layout, GLuint offset = 0) {
+            VertexLayout::Attribute& attribute = layout.attributes[First::location()];
+            attribute.offset = offset;
+            attribute.type = First::type();
+            attribute.components = First::components();
+            attribute.normalized = First::normalized();
+            VertexFormat<Rest...>::describe(layout, offset + First::size());
+        }
+
+        static VertexLayout layout() {
+            VertexLayout layout;
+            layout.setup = &setup;
+            layout.stride = (GLsizei)stride();
+            describe(layout);
+            return layout;
+        }
+    };
+
+    template<class Format>
+    void packVertices(const VertexSource& source, std::size_t count,
+        std::vector<unsigned char>& out) {
+        out.resize(count * Format::stride());
+        for (std::size_t i = 0; i < count; i++) {
+            Format::pack(source, i, &out[i * Format::stride()]);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+}  // namespace mgl
+
+#endif /* MGL_VERTEX_FORMAT_HPP */
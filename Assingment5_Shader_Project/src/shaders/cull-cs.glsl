@@ -0,0 +1,149 @@
+#version 460 core
+
+// GPU-driven scene: one invocation per node. Composes the node matrices,
+// culls its bounding sphere against the frustum, picks a level of detail
+// by how much of the screen height the sphere covers and appends a draw
+// command, at gl_BaseInstance = node, for every range of that level that
+// is inside the frustum and not facing away from the eye.
+
+layout(local_size_x = 64) in;
+
+struct Object {
+   mat4 ModelMatrix;
+   mat3 NormalMatrix;
+   vec3 Color;
+   uint Layout;
+};
+
+struct Node {
+   vec4 Translation;
+   vec4 Rotation;
+   vec4 Scale;
+   vec4 Color;
+   uint Mesh;
+   uint Batch;
+};
+
+// levels are sorted by decreasing screen size
+struct Mesh {
+   mat4 PositionMatrix;
+   vec4 Sphere;
+   vec4 LodScreenSize;
+   uvec4 FirstRange;
+   uvec4 RangeCount;
+   uint LodCount;
+   uint Layout;
+};
+
+// Draw = (firstIndex, indexCount, baseVertex, -); Cone = (axis, cutoff)
+struct Range {
+   vec4 Sphere;
+   vec4 Cone;
+   uvec4 Draw;
+};
+
+struct Command {
+   uint Count;
+   uint InstanceCount;
+   uint FirstIndex;
+   int BaseVertex;
+   uint BaseInstance;
+};
+
+layout(std430, binding = 0) writeonly buffer Objects { Object objects[]; };
+layout(std430, binding = 1) readonly buffer Nodes { Node nodes[]; };
+layout(std430, binding = 2) readonly buffer Meshes { Mesh meshes[]; };
+layout(std430, binding = 3) readonly buffer Ranges { Range ranges[]; };
+layout(std430, binding = 4) readonly buffer Batches { uint batchOffsets[]; };
+layout(std430, binding = 5) writeonly buffer Commands { Command commands[]; };
+layout(std430, binding = 6) buffer Counts { uint counts[]; };
+
+uniform mat4 ViewProjectionMatrix;
+uniform vec3 EyePosition;
+uniform float ProjectionScale;
+uniform uint NodeCount;
+
+const uint NO_MESH = 0xFFFFFFFFu;
+
+mat3 rotationMatrix(vec4 q)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+	return mat3(
+		1.0 - 2.0 * (yy + zz), 2.0 * (xy + wz), 2.0 * (xz - wy),
+		2.0 * (xy - wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + wx),
+		2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (xx + yy));
+}
+
+bool insideFrustum(vec4 planes[6], vec3 center, float radius)
+{
+	for (int i = 0; i < 6; i++) {
+		if (dot(planes[i].xyz, center) + planes[i].w < -radius) return false;
+	}
+	return true;
+}
+
+void main(void)
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= NodeCount) return;
+	Node node = nodes[index];
+	if (node.Mesh == NO_MESH) return;
+	Mesh mesh = meshes[node.Mesh];
+
+	// world = T * R * S, normal = R * inverse(S)
+	mat3 R = rotationMatrix(node.Rotation);
+	vec3 s = node.Scale.xyz;
+	mat4 world = mat4(
+		vec4(R[0] * s.x, 0.0), vec4(R[1] * s.y, 0.0), vec4(R[2] * s.z, 0.0),
+		vec4(node.Translation.xyz, 1.0));
+	objects[index].ModelMatrix = world * mesh.PositionMatrix;
+	objects[index].NormalMatrix = mat3(R[0] / s.x, R[1] / s.y, R[2] / s.z);
+	objects[index].Color = node.Color.rgb;
+	objects[index].Layout = mesh.Layout;
+
+	// frustum planes from the rows of the view-projection matrix
+	mat4 m = transpose(ViewProjectionMatrix);
+	vec4 planes[6] = vec4[6](
+		m[3] + m[0], m[3] - m[0],
+		m[3] + m[1], m[3] - m[1],
+		m[3] + m[2], m[3] - m[2]);
+	for (int i = 0; i < 6; i++) {
+		planes[i] /= length(planes[i].xyz);
+	}
+
+	float scale = max(abs(s.x), max(abs(s.y), abs(s.z)));
+	vec3 center = vec3(world * vec4(mesh.Sphere.xyz, 1.0));
+	float radius = mesh.Sphere.w * scale;
+	if (!insideFrustum(planes, center, radius)) return;
+
+	float screenSize = radius * ProjectionScale / max(distance(center, EyePosition), 1e-4);
+	uint level = 0;
+	for (uint l = 1; l < mesh.LodCount; l++) {
+		if (screenSize < mesh.LodScreenSize[l]) level = l;
+	}
+
+	// cones are tested in model space, where the eye is inverse(world) * eye
+	vec3 eye = (transpose(R) * (EyePosition - node.Translation.xyz)) / s;
+	uint first = mesh.FirstRange[level];
+	uint last = first + mesh.RangeCount[level];
+	for (uint r = first; r < last; r++) {
+		Range range = ranges[r];
+		if (mesh.RangeCount[level] > 1 && !insideFrustum(planes,
+			vec3(world * vec4(range.Sphere.xyz, 1.0)), range.Sphere.w * scale)) {
+			continue;
+		}
+		vec3 view = range.Sphere.xyz - eye;
+		if (dot(view, range.Cone.xyz) >= range.Cone.w * length(view) + range.Sphere.w) {
+			continue;
+		}
+
+		uint slot = batchOffsets[node.Batch] + atomicAdd(counts[node.Batch], 1u);
+		commands[slot].Count = range.Draw.y;
+		commands[slot].InstanceCount = 1u;
+		commands[slot].FirstIndex = range.Draw.x;
+		commands[slot].BaseVertex = int(range.Draw.z);
+		commands[slot].BaseInstance = index;
+	}
+}
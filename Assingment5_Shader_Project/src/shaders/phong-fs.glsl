@@ -1,13 +1,29 @@
 #version 330 core
 
+// VERTEX_COLORS: GPU-driven and static batch draws, whose color comes from
+// the vertex shader, which read it from the node's Object or from the
+// baked vertex.
 in vec3 exNormal;
 in vec3 exFragPosition;
+#ifdef VERTEX_COLORS
+flat in vec3 exColor;
+#define Color exColor
+#endif
 
 out vec4 FragmentColor;
 
-uniform vec3 Color;
-uniform vec3 LightPosition;
-uniform vec3 EyePosition;
+#ifndef VERTEX_COLORS
+layout(std140) uniform Object {
+   mat4 ModelMatrix;
+   mat3 NormalMatrix;
+   vec3 Color;
+};
+#endif
+
+layout(std140) uniform Frame {
+   vec3 LightPosition;
+   vec3 EyePosition;
+};
 
 void main(void)
 {
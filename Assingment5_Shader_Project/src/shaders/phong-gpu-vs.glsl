@@ -0,0 +1,38 @@
+#version 460 core
+
+// GPU-driven draws: every command carries its node in gl_BaseInstance,
+// and the culling pass wrote that node's Object at the same index.
+in vec3 inPosition;
+in vec3 inNormal;
+
+out vec3 exNormal;
+out vec3 exFragPosition;
+flat out vec3 exColor;
+
+struct Object {
+   mat4 ModelMatrix;
+   mat3 NormalMatrix;
+   vec3 Color;
+   uint Layout;
+};
+
+layout(std430, binding = 0) readonly buffer Objects {
+   Object objects[];
+};
+
+uniform Camera {
+   mat4 ViewMatrix;
+   mat4 ProjectionMatrix;
+};
+
+void main(void)
+{
+	Object object = objects[gl_BaseInstance];
+	vec4 MCPosition = vec4(inPosition, 1.0);
+
+	exNormal = object.NormalMatrix * inNormal;
+	exFragPosition = vec3(object.ModelMatrix * MCPosition);
+	exColor = object.Color;
+
+	gl_Position = ProjectionMatrix * ViewMatrix * object.ModelMatrix * MCPosition;
+}
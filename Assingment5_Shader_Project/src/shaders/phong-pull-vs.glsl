@@ -0,0 +1,90 @@
+#version 460 core
+
+// GPU-driven draws with vertex pulling: there are no vertex attributes.
+// The pool arena is read as words, vertex gl_VertexID - gl_BaseVertex of
+// the range starting at word gl_BaseVertex, and decoded with the layout
+// of the node's mesh. Compressed normals are octahedral-encoded in xy.
+out vec3 exNormal;
+out vec3 exFragPosition;
+flat out vec3 exColor;
+
+struct Object {
+   mat4 ModelMatrix;
+   mat3 NormalMatrix;
+   vec3 Color;
+   uint Layout;
+};
+
+// Attributes[location] = (offset in bytes, GL type, components, normalized)
+struct Layout {
+   uvec4 Stride;
+   uvec4 Attributes[8];
+};
+
+layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };
+layout(std430, binding = 7) readonly buffer Vertices { uint words[]; };
+layout(std430, binding = 8) readonly buffer Layouts { Layout layouts[]; };
+
+uniform Camera {
+   mat4 ViewMatrix;
+   mat4 ProjectionMatrix;
+};
+
+// locations of mgl::Mesh
+const uint POSITION = 1u;
+const uint NORMAL = 2u;
+
+// GL types of mglVertexFormat.hpp
+const uint FLOAT = 0x1406u;
+const uint UNSIGNED_SHORT = 0x1403u;
+const uint HALF_FLOAT = 0x140Bu;
+const uint INT_2_10_10_10_REV = 0x8D9Fu;
+
+vec4 fetch(uint vertex, uvec4 attribute)
+{
+	if (attribute.z == 0u) return vec4(0.0, 0.0, 0.0, 1.0);
+	uint word = vertex + attribute.x / 4u;
+	vec4 value = vec4(0.0, 0.0, 0.0, 1.0);
+	if (attribute.y == FLOAT) {
+		for (uint i = 0u; i < attribute.z; i++) {
+			value[i] = uintBitsToFloat(words[word + i]);
+		}
+	}
+	else if (attribute.y == UNSIGNED_SHORT) {
+		value.xy = unpackUnorm2x16(words[word]);
+		if (attribute.z > 2u) value.zw = unpackUnorm2x16(words[word + 1u]);
+		if (attribute.z < 4u) value.w = 1.0;
+	}
+	else if (attribute.y == HALF_FLOAT) {
+		value.xy = unpackHalf2x16(words[word]);
+		if (attribute.z > 2u) value.zw = unpackHalf2x16(words[word + 1u]);
+		if (attribute.z < 4u) value.w = 1.0;
+	}
+	else if (attribute.y == INT_2_10_10_10_REV) {
+		int packed = int(words[word]);
+		value = vec4(bitfieldExtract(packed, 0, 10), bitfieldExtract(packed, 10, 10),
+			bitfieldExtract(packed, 20, 10), bitfieldExtract(packed, 30, 2));
+		value = max(value / vec4(511.0, 511.0, 511.0, 1.0), -1.0);
+	}
+	return value;
+}
+
+#include "octahedral.glsl"
+
+void main(void)
+{
+	Object object = objects[gl_BaseInstance];
+	Layout format = layouts[object.Layout];
+	uint vertex = uint(gl_BaseVertex) + uint(gl_VertexID - gl_BaseVertex) * format.Stride.x;
+
+	vec4 MCPosition = vec4(fetch(vertex, format.Attributes[POSITION]).xyz, 1.0);
+	uvec4 normalAttribute = format.Attributes[NORMAL];
+	vec4 normal = fetch(vertex, normalAttribute);
+	vec3 MCNormal = normalAttribute.y == FLOAT ? normal.xyz : decodeOctahedral(normal.xy);
+
+	exNormal = object.NormalMatrix * MCNormal;
+	exFragPosition = vec3(object.ModelMatrix * MCPosition);
+	exColor = object.Color;
+
+	gl_Position = ProjectionMatrix * ViewMatrix * object.ModelMatrix * MCPosition;
+}
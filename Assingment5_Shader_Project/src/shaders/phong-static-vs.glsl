@@ -0,0 +1,24 @@
+#version 330 core
+
+// Static batch: vertices were baked into world space with the node color.
+in vec3 inPosition;
+in vec3 inNormal;
+in vec3 inColor;
+
+out vec3 exNormal;
+out vec3 exFragPosition;
+flat out vec3 exColor;
+
+uniform Camera {
+   mat4 ViewMatrix;
+   mat4 ProjectionMatrix;
+};
+
+void main(void)
+{
+	exNormal = inNormal;
+	exFragPosition = inPosition;
+	exColor = inColor;
+
+	gl_Position = ProjectionMatrix * ViewMatrix * vec4(inPosition, 1.0);
+}
@@ -1,23 +1,42 @@
 #version 330 core
 
+// COMPRESSED_VERTICES: positions are unorm16 inside the mesh bounding box
+// (undone by ModelMatrix), normals octahedral-encoded in xy. Tangents,
+// when present, are encoded the same way with the bitangent's handedness
+// in w: B = cross(N, T) * inTangent.w.
 in vec3 inPosition;
+#ifdef COMPRESSED_VERTICES
+in vec4 inNormal;
+#else
 in vec3 inNormal;
+#endif
 
 out vec3 exNormal;
 out vec3 exFragPosition;
 
-uniform mat4 ModelMatrix;
+layout(std140) uniform Object {
+   mat4 ModelMatrix;
+   mat3 NormalMatrix;
+   vec3 Color;
+};
 
 uniform Camera {
    mat4 ViewMatrix;
    mat4 ProjectionMatrix;
 };
 
+#include "octahedral.glsl"
+
 void main(void)
 {
 	vec4 MCPosition = vec4(inPosition, 1.0);
+#ifdef COMPRESSED_VERTICES
+	vec3 MCNormal = decodeOctahedral(inNormal.xy);
+#else
+	vec3 MCNormal = inNormal;
+#endif
 	
-	exNormal = mat3(transpose(inverse(ModelMatrix))) * inNormal;
+	exNormal = NormalMatrix * MCNormal;
 	exFragPosition = vec3(ModelMatrix * MCPosition);
 
 	gl_Position = ProjectionMatrix * ViewMatrix * ModelMatrix * MCPosition;